@@ -0,0 +1,141 @@
+// Contention on the process list lock: reader threads look processes up (a titleId lookup, then a walk like the
+// process monitor's handle array rebuild) while a writer keeps launching and deleting a process, the way PM's threads
+// share the list. Run once with the readers taking the lock shared, then with them taking it exclusively like before
+// it was a reader/writer lock, for 1 to 8 readers.
+//
+// Usage: bench_lock [duration per run in ms] [writer pause in us]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <3ds.h>
+
+#include "process_data.h"
+#include "util.h"
+
+#define NUM_PROCESSES   0x40
+#define MAX_READERS     8
+
+#define SYSMODULE_TID(n)    (0x0004013000001002ULL + ((u64)(n) << 8))
+
+typedef struct ReaderStats {
+    u64 numOps;
+    u64 totalWaitTicks;
+    u64 maxWaitTicks;
+} ReaderStats;
+
+static ProcessList g_list;
+static volatile bool g_stop;
+static bool g_readersShared;
+static s64 g_writerPause;
+
+static void *readerThread(void *arg)
+{
+    ReaderStats *stats = (ReaderStats *)arg;
+    u32 i = 0;
+
+    while (!__atomic_load_n(&g_stop, __ATOMIC_RELAXED)) {
+        u64 tick = svcGetSystemTick();
+        if (g_readersShared) {
+            ProcessList_LockShared(&g_list);
+        } else {
+            ProcessList_Lock(&g_list);
+        }
+        u64 waitTicks = svcGetSystemTick() - tick;
+
+        ProcessData *process = ProcessList_FindProcessByTitleId(&g_list, SYSMODULE_TID(i++ % NUM_PROCESSES));
+        u32 numHandles = process != NULL ? 1 : 0;
+        FOREACH_PROCESS(&g_list, process) {
+            numHandles += ProcessList_GetHandle(&g_list, process) != 0 ? 1 : 0;
+        }
+
+        if (g_readersShared) {
+            ProcessList_UnlockShared(&g_list);
+        } else {
+            ProcessList_Unlock(&g_list);
+        }
+
+        stats->numOps += numHandles != 0 ? 1 : 0;
+        stats->totalWaitTicks += waitTicks;
+        stats->maxWaitTicks = waitTicks > stats->maxWaitTicks ? waitTicks : stats->maxWaitTicks;
+    }
+
+    return NULL;
+}
+
+static void *writerThread(void *arg)
+{
+    u64 *numOps = (u64 *)arg;
+
+    while (!__atomic_load_n(&g_stop, __ATOMIC_RELAXED)) {
+        ProcessList_Lock(&g_list);
+        ProcessData *process = ProcessList_New(&g_list, 0x9000, 0x1000, SYSMODULE_TID(NUM_PROCESSES));
+        if (process != NULL) {
+            ProcessList_AddFlags(&g_list, process, PROCESSFLAG_NOTIFY_TERMINATION);
+            ProcessList_Delete(&g_list, process);
+        }
+        ProcessList_Unlock(&g_list);
+
+        ++*numOps;
+        if (g_writerPause > 0) {
+            svcSleepThread(g_writerPause);
+        }
+    }
+
+    return NULL;
+}
+
+static void run(u32 numReaders, bool shared, s64 duration)
+{
+    pthread_t readers[MAX_READERS], writer;
+    ReaderStats stats[MAX_READERS] = {{0}};
+    u64 numWriterOps = 0;
+
+    g_readersShared = shared;
+    g_stop = false;
+    for (u32 i = 0; i < numReaders; i++) {
+        pthread_create(&readers[i], NULL, readerThread, &stats[i]);
+    }
+    pthread_create(&writer, NULL, writerThread, &numWriterOps);
+
+    svcSleepThread(duration);
+    __atomic_store_n(&g_stop, true, __ATOMIC_RELAXED);
+
+    for (u32 i = 0; i < numReaders; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    pthread_join(writer, NULL);
+
+    ReaderStats total = {0};
+    for (u32 i = 0; i < numReaders; i++) {
+        total.numOps += stats[i].numOps;
+        total.totalWaitTicks += stats[i].totalWaitTicks;
+        total.maxWaitTicks = stats[i].maxWaitTicks > total.maxWaitTicks ? stats[i].maxWaitTicks : total.maxWaitTicks;
+    }
+
+    double seconds = duration / 1e9;
+    printf("  %-10s %7lu %14.0f %12.0f %12.1f %12.1f\n", shared ? "shared" : "exclusive", (unsigned long)numReaders,
+        total.numOps / seconds, numWriterOps / seconds, total.numOps != 0 ? ticksToNs(total.totalWaitTicks / total.numOps) / 1000.0 : 0.0,
+        ticksToNs(total.maxWaitTicks) / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    s64 duration = (argc > 1 ? strtoll(argv[1], NULL, 0) : 500) * 1000 * 1000;
+    g_writerPause = (argc > 2 ? strtoll(argv[2], NULL, 0) : 50) * 1000;
+
+    ProcessList_Init(&g_list, malloc(PROCESSLIST_BUFFER_SIZE(NUM_PROCESSES + 1)), NUM_PROCESSES + 1);
+    for (u32 i = 0; i < NUM_PROCESSES; i++) {
+        ProcessList_New(&g_list, 0x8000 + 0x40 * i, 0x20 + i, SYSMODULE_TID(i));
+    }
+
+    printf("%u processes, %lld ms per run, the writer pauses %lld us between updates\n", NUM_PROCESSES,
+        (long long)duration / 1000000, (long long)g_writerPause / 1000);
+    printf("\n  readers    threads  reader ops/s  writer ops/s  avg wait us  max wait us\n");
+    for (u32 numReaders = 1; numReaders <= MAX_READERS; numReaders *= 2) {
+        run(numReaders, true, duration);
+        run(numReaders, false, duration);
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// ProcessList lookups with a full pool of 0x40 processes: the indexes (ProcessList_FindProcessBy*) against a walk of
+// the list, which is what they replaced. Prints the lock hold time per lookup, i.e. the time the lookup itself takes,
+// and the time of a whole lock, lookup, unlock sequence.
+//
+// Usage: bench_lookup [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <3ds.h>
+
+#include "process_data.h"
+#include "util.h"
+
+#define NUM_PROCESSES   0x40
+
+typedef enum LookupKind {
+    LOOKUP_PID = 0,
+    LOOKUP_HANDLE,
+    LOOKUP_TITLEID,
+
+    LOOKUP_COUNT,
+} LookupKind;
+
+static ProcessList g_list;
+static u64 g_keys[LOOKUP_COUNT][NUM_PROCESSES + 1]; // the last one is missing from the list
+static volatile uintptr_t g_sink;
+
+// What the lookups did before the indexes
+static ProcessData *findByWalking(const ProcessList *list, LookupKind kind, u64 key)
+{
+    ProcessData *process;
+
+    FOREACH_PROCESS(list, process) {
+        if ((kind == LOOKUP_PID && ProcessList_GetPid(list, process) == key) ||
+            (kind == LOOKUP_HANDLE && ProcessList_GetHandle(list, process) == key) ||
+            (kind == LOOKUP_TITLEID && (process->titleId & ~0xFFULL) == (key & ~0xFFULL))) {
+            return process;
+        }
+    }
+
+    return NULL;
+}
+
+static ProcessData *findIndexed(const ProcessList *list, LookupKind kind, u64 key)
+{
+    switch (kind) {
+        case LOOKUP_PID:
+            return ProcessList_FindProcessById(list, (u32)key);
+        case LOOKUP_HANDLE:
+            return ProcessList_FindProcessByHandle(list, (Handle)key);
+        default:
+            return ProcessList_FindProcessByTitleId(list, key);
+    }
+}
+
+static void fillList(void)
+{
+    ProcessList_Init(&g_list, malloc(PROCESSLIST_BUFFER_SIZE(NUM_PROCESSES)), NUM_PROCESSES);
+
+    // Fill the pool, remove every other process and fill it again, so that the list order doesn't follow the pool
+    ProcessData *processes[NUM_PROCESSES];
+    u32 numKeys = 0;
+    for (u32 i = 0; i < NUM_PROCESSES + NUM_PROCESSES / 2; i++) {
+        if (i == NUM_PROCESSES) {
+            for (u32 j = 1; j < NUM_PROCESSES; j += 2) {
+                ProcessList_Delete(&g_list, processes[j]);
+            }
+        }
+
+        u32 pid = 0x20 + i;
+        Handle handle = 0x8000 + 0x40 * i; // the kernel spaces its handles out like this
+        u64 titleId = 0x0004013000001002ULL + ((u64)i << 8);
+        ProcessData *process = ProcessList_New(&g_list, handle, pid, titleId);
+        if (i < NUM_PROCESSES) {
+            processes[i] = process;
+        }
+    }
+
+    ProcessData *process;
+    FOREACH_PROCESS(&g_list, process) {
+        g_keys[LOOKUP_PID][numKeys] = ProcessList_GetPid(&g_list, process);
+        g_keys[LOOKUP_HANDLE][numKeys] = ProcessList_GetHandle(&g_list, process);
+        g_keys[LOOKUP_TITLEID][numKeys] = process->titleId | 0x20000000; // N3DS variant, found through the mask
+        ++numKeys;
+    }
+
+    g_keys[LOOKUP_PID][NUM_PROCESSES] = 0x1000;
+    g_keys[LOOKUP_HANDLE][NUM_PROCESSES] = 0xFFFF8001; // CUR_PROCESS_HANDLE
+    g_keys[LOOKUP_TITLEID][NUM_PROCESSES] = 0x0004013000FFFF02ULL;
+}
+
+// Average per lookup, in ns, over all the keys (each process, plus one that's missing)
+static double timeLookups(ProcessData *(*find)(const ProcessList *, LookupKind, u64), LookupKind kind, u32 rounds, bool lockEach)
+{
+    uintptr_t sink = 0;
+    u64 tick = svcGetSystemTick();
+
+    if (!lockEach) {
+        ProcessList_LockShared(&g_list);
+    }
+
+    for (u32 round = 0; round < rounds; round++) {
+        for (u32 i = 0; i <= NUM_PROCESSES; i++) {
+            if (lockEach) {
+                ProcessList_LockShared(&g_list);
+            }
+            sink += (uintptr_t)find(&g_list, kind, g_keys[kind][i]);
+            if (lockEach) {
+                ProcessList_UnlockShared(&g_list);
+            }
+        }
+    }
+
+    if (!lockEach) {
+        ProcessList_UnlockShared(&g_list);
+    }
+
+    g_sink = sink;
+    return (double)ticksToNs(svcGetSystemTick() - tick) / ((double)rounds * (NUM_PROCESSES + 1));
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const kindNames[LOOKUP_COUNT] = { "by pid", "by handle", "by titleId" };
+    u32 rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+
+    fillList();
+
+    // Both must agree before anything is timed
+    for (u32 kind = 0; kind < LOOKUP_COUNT; kind++) {
+        for (u32 i = 0; i <= NUM_PROCESSES; i++) {
+            if (findIndexed(&g_list, (LookupKind)kind, g_keys[kind][i]) != findByWalking(&g_list, (LookupKind)kind, g_keys[kind][i])) {
+                fprintf(stderr, "lookup %s mismatch for key %llx\n", kindNames[kind], (unsigned long long)g_keys[kind][i]);
+                return 1;
+            }
+        }
+    }
+
+    printf("%u processes, %lu rounds over each of them plus a missing one\n", NUM_PROCESSES, (unsigned long)rounds);
+    printf("\n(ns per lookup)      hold: walk    indexed    lock+lookup+unlock: walk    indexed\n");
+    for (u32 kind = 0; kind < LOOKUP_COUNT; kind++) {
+        double walkHold = timeLookups(findByWalking, (LookupKind)kind, rounds, false);
+        double indexedHold = timeLookups(findIndexed, (LookupKind)kind, rounds, false);
+        double walkTotal = timeLookups(findByWalking, (LookupKind)kind, rounds, true);
+        double indexedTotal = timeLookups(findIndexed, (LookupKind)kind, rounds, true);
+        printf("  %-16s %10.1f %10.1f %28.1f %10.1f\n", kindNames[kind], walkHold, indexedHold, walkTotal, indexedTotal);
+    }
+
+    return 0;
+}
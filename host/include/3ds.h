@@ -0,0 +1,18 @@
+#pragma once
+
+// Subset of libctru's declarations used by source/, for the host build (see host/Makefile).
+// Implemented by the simulated kernel and services in host/shim.
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/os.h>
+#include <3ds/svc.h>
+#include <3ds/ipc.h>
+#include <3ds/synchronization.h>
+#include <3ds/exheader.h>
+#include <3ds/srv.h>
+#include <3ds/services/fs.h>
+#include <3ds/services/fsreg.h>
+#include <3ds/services/loader.h>
+#include <3ds/services/srvpm.h>
+#include <3ds/services/pmapp.h>
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef enum {
+    SYSMODE_O3DS_PROD   = 0,
+    SYSMODE_N3DS_PROD   = 1,
+    SYSMODE_DEV1        = 2,
+    SYSMODE_DEV2        = 3,
+    SYSMODE_DEV3        = 4,
+    SYSMODE_DEV4        = 5,
+} SystemMode;
+
+typedef enum {
+    RESLIMIT_CATEGORY_APPLICATION   = 0,
+    RESLIMIT_CATEGORY_SYS_APPLET    = 1,
+    RESLIMIT_CATEGORY_LIB_APPLET    = 2,
+    RESLIMIT_CATEGORY_OTHER         = 3,
+} ResourceLimitCategory;
+
+typedef struct {
+    u8 reserved[5];
+    u8 flag;
+    u16 remaster_version;
+} PACKED ExHeader_SystemInfoFlags;
+
+typedef struct {
+    u32 address;
+    u32 num_pages;
+    u32 size;
+} ExHeader_CodeSectionInfo;
+
+typedef struct {
+    char name[8];
+    ExHeader_SystemInfoFlags flags;
+    ExHeader_CodeSectionInfo text;
+    u32 stack_size;
+    ExHeader_CodeSectionInfo rodata;
+    u32 reserved;
+    ExHeader_CodeSectionInfo data;
+    u32 bss_size;
+} ExHeader_CodeSetInfo;
+
+typedef struct {
+    u64 savedata_size;
+    u64 jump_id;
+    u8 reserved[0x30];
+} ExHeader_SystemInfo;
+
+typedef struct {
+    ExHeader_CodeSetInfo codeset_info;
+    u64 dependencies[48];
+    ExHeader_SystemInfo system_info;
+} ExHeader_SystemControlInfo;
+
+typedef struct {
+    u32 core_version;
+    u8 reserved[2];
+    u8 flag1;
+    SystemMode n3ds_system_mode : 4;
+    u8 flag2_unused : 4;
+    u8 ideal_processor : 2;
+    u8 affinity_mask : 2;
+    SystemMode o3ds_system_mode : 4;
+    s8 priority;
+} PACKED ExHeader_Arm11CoreInfo;
+
+typedef struct {
+    u64 extdata_id;
+    u64 system_savedata_ids[2];
+    u64 accessible_savedata_ids;
+    u32 fs_access_info;
+    u32 other_attributes;
+} PACKED ExHeader_Arm11StorageInfo;
+
+typedef struct {
+    u64 title_id;
+    ExHeader_Arm11CoreInfo core_info;
+    u16 reslimits[16];
+    ExHeader_Arm11StorageInfo storage_info;
+    char service_access[34][8];
+    u8 reserved[15];
+    ResourceLimitCategory reslimit_category : 8;
+} PACKED ExHeader_Arm11SystemLocalCapabilities;
+
+typedef struct {
+    u32 descriptors[28];
+    u8 reserved[0x10];
+} ExHeader_Arm11KernelCapabilities;
+
+typedef struct {
+    u8 descriptors[15];
+    u8 descriptor_version;
+} ExHeader_Arm9AccessControl;
+
+typedef struct {
+    ExHeader_Arm11SystemLocalCapabilities local_caps;
+    ExHeader_Arm11KernelCapabilities kernel_caps;
+    ExHeader_Arm9AccessControl access_control;
+} ExHeader_AccessControlInfo;
+
+typedef struct {
+    ExHeader_SystemControlInfo sci;
+    ExHeader_AccessControlInfo aci;
+} ExHeader_Info;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef enum {
+    IPC_BUFFER_R  = BIT(1),
+    IPC_BUFFER_W  = BIT(2),
+    IPC_BUFFER_RW = IPC_BUFFER_R | IPC_BUFFER_W,
+} IPC_BufferRights;
+
+static inline u32 IPC_MakeHeader(u16 command_id, unsigned normal_params, unsigned translate_params)
+{
+    return ((u32)command_id << 16) | (((u32)normal_params & 0x3F) << 6) | ((u32)translate_params & 0x3F);
+}
+
+static inline u32 IPC_Desc_Buffer(size_t size, IPC_BufferRights rights)
+{
+    return ((u32)size << 4) | 0x8 | rights;
+}
+
+static inline u32 IPC_Desc_MoveHandles(unsigned number)
+{
+    return ((u32)(number - 1) << 26) | 0x10;
+}
+
+static inline u32 IPC_Desc_SharedHandles(unsigned number)
+{
+    return (u32)(number - 1) << 26;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <3ds/types.h>
+
+#define SYSCLOCK_ARM11          268111856LL
+#define SYSTEM_VERSION(major, minor, revision) (((major) << 24) | ((minor) << 16) | ((revision) << 8))
+
+#define OS_HEAP_AREA_BEGIN      0x08000000
+
+u32 osGetFirmVersion(void);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <3ds/types.h>
+
+#define R_SUCCEEDED(res)    ((res) >= 0)
+#define R_FAILED(res)       ((res) < 0)
+#define R_LEVEL(res)        (((res) >> 27) & 0x1F)
+#define R_SUMMARY(res)      (((res) >> 21) & 0x3F)
+#define R_MODULE(res)       (((res) >> 10) & 0xFF)
+#define R_DESCRIPTION(res)  ((res) & 0x3FF)
+
+#define MAKERESULT(level, summary, module, description) \
+    ((((level) & 0x1F) << 27) | (((summary) & 0x3F) << 21) | (((module) & 0xFF) << 10) | ((description) & 0x3FF))
+
+enum {
+    RS_SUCCESS = 0,
+    RS_NOP,
+    RS_WOULDBLOCK,
+    RS_OUTOFRESOURCE,
+    RS_NOTFOUND,
+    RS_INVALIDSTATE,
+    RS_NOTSUPPORTED,
+    RS_INVALIDARG,
+    RS_WRONGARG,
+    RS_CANCELED,
+    RS_STATUSCHANGED,
+    RS_INTERNAL,
+    RS_INVALIDRESVAL = 63,
+};
+
+enum {
+    RD_SUCCESS = 0,
+    RD_TIMEOUT = 1022,
+    RD_NOT_IMPLEMENTED = 1012,
+};
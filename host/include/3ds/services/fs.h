@@ -0,0 +1,15 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef enum {
+    MEDIATYPE_NAND      = 0,
+    MEDIATYPE_SD        = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef struct {
+    u64 programId;
+    FS_MediaType mediaType : 8;
+    u8 padding[7];
+} PACKED FS_ProgramInfo;
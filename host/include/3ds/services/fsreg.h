@@ -0,0 +1,12 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/exheader.h>
+#include <3ds/services/fs.h>
+
+Result fsRegInit(void);
+void fsRegExit(void);
+Handle *fsRegGetSessionHandle(void);
+
+Result FSREG_Register(u32 pid, u64 prog_handle, const FS_ProgramInfo *info, const ExHeader_Arm11StorageInfo *storageinfo);
+Result FSREG_Unregister(u32 pid);
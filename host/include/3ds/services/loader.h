@@ -0,0 +1,14 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/exheader.h>
+#include <3ds/services/fs.h>
+
+Result loaderInit(void);
+void loaderExit(void);
+Handle *loaderGetSessionHandle(void);
+
+Result LOADER_LoadProcess(Handle *process, u64 programHandle);
+Result LOADER_RegisterProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate);
+Result LOADER_UnregisterProgram(u64 programHandle);
+Result LOADER_GetProgramInfo(ExHeader_Info *exheaderInfo, u64 programHandle);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef enum {
+    PMLAUNCHFLAG_NORMAL_APPLICATION             = BIT(0),
+    PMLAUNCHFLAG_LOAD_DEPENDENCIES              = BIT(1),
+    PMLAUNCHFLAG_NOTIFY_TERMINATION             = BIT(2),
+    PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION        = BIT(3),
+    PMLAUNCHFLAG_TERMINATION_NOTIFICATION_MASK  = 0xF0,
+    PMLAUNCHFLAG_FORCE_USE_O3DS_APP_MEM         = BIT(8),
+    PMLAUNCHFLAG_FORCE_USE_O3DS_MAX_APP_MEM     = BIT(9),
+    PMLAUNCHFLAG_USE_UPDATE_TITLE               = BIT(16),
+} PmLaunchFlags;
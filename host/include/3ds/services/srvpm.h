@@ -0,0 +1,12 @@
+#pragma once
+
+#include <3ds/types.h>
+
+Result srvPmInit(void);
+void srvPmExit(void);
+Handle *srvPmGetSessionHandle(void);
+
+Result SRVPM_PublishToProcess(u32 notificationId, Handle process);
+Result SRVPM_PublishToAll(u32 notificationId);
+Result SRVPM_RegisterProcess(u32 pid, u32 count, const char (*serviceAccessControlList)[8]);
+Result SRVPM_UnregisterProcess(u32 pid);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <3ds/types.h>
+
+Result srvEnableNotification(Handle *semaphoreOut);
+Result srvSubscribe(u32 notificationId);
+Result srvUnsubscribe(u32 notificationId);
+Result srvReceiveNotification(u32 *notificationIdOut);
+Result srvPublishToSubscriber(u32 notificationId, u32 flags);
+Result srvRegisterService(Handle *out, const char *name, int maxSessions);
+Result srvUnregisterService(const char *name);
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <3ds/types.h>
+
+#define CUR_PROCESS_HANDLE  0xFFFF8001
+
+typedef enum {
+    MEMOP_FREE          = 1,
+    MEMOP_RESERVE       = 2,
+    MEMOP_ALLOC         = 3,
+    MEMOP_MAP           = 4,
+    MEMOP_UNMAP         = 5,
+    MEMOP_PROT          = 6,
+    MEMOP_REGION_APP    = 0x100,
+    MEMOP_REGION_SYSTEM = 0x200,
+    MEMOP_REGION_BASE   = 0x300,
+} MemOp;
+
+typedef enum {
+    MEMPERM_READ        = 1,
+    MEMPERM_WRITE       = 2,
+    MEMPERM_EXECUTE     = 4,
+    MEMPERM_DONTCARE    = 0x10000000,
+} MemPerm;
+
+typedef enum {
+    RESET_ONESHOT = 0,
+    RESET_STICKY  = 1,
+    RESET_PULSE   = 2,
+} ResetType;
+
+typedef enum {
+    RESLIMIT_PRIORITY       = 0,
+    RESLIMIT_COMMIT         = 1,
+    RESLIMIT_THREAD         = 2,
+    RESLIMIT_EVENT          = 3,
+    RESLIMIT_MUTEX          = 4,
+    RESLIMIT_SEMAPHORE      = 5,
+    RESLIMIT_TIMER          = 6,
+    RESLIMIT_SHAREDMEMORY   = 7,
+    RESLIMIT_ADDRESSARBITER = 8,
+    RESLIMIT_CPUTIME        = 9,
+
+    RESLIMIT_BIT = BIT(31),
+} ResourceLimitType;
+
+typedef enum {
+    USERBREAK_PANIC   = 0,
+    USERBREAK_ASSERT  = 1,
+    USERBREAK_USER    = 2,
+} UserBreakType;
+
+typedef struct {
+    s32 priority;
+    u32 stack_size;
+    s32 argc;
+    u16 *argv;
+    u16 *envp;
+} StartupInfo;
+
+/// The thread's IPC command buffer, in its thread local storage
+u32 *getThreadCommandBuffer(void);
+void *getThreadLocalStorage(void);
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm);
+void svcExitProcess(void) __attribute__((noreturn));
+Result svcCreateThread(Handle *thread, ThreadFunc entrypoint, u32 arg, u32 *stack_top, s32 thread_priority, s32 processor_id);
+void svcExitThread(void) __attribute__((noreturn));
+void svcSleepThread(s64 ns);
+
+Result svcCreateEvent(Handle *event, ResetType reset_type);
+Result svcSignalEvent(Handle handle);
+Result svcClearEvent(Handle handle);
+Result svcCloseHandle(Handle handle);
+Result svcDuplicateHandle(Handle *out, Handle original);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds);
+
+u64 svcGetSystemTick(void);
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param);
+Result svcKernelSetState(u32 type, ...);
+
+Result svcOpenProcess(Handle *process, u32 processId);
+Result svcGetProcessId(u32 *out, Handle handle);
+Result svcTerminateProcess(Handle process);
+Result svcRun(Handle process, const StartupInfo *info);
+Result svcSetProcessAffinityMask(Handle process, const u8 *affinitymask, s32 processorcount);
+Result svcSetProcessIdealProcessor(Handle process, s32 processorid);
+Result svcDebugActiveProcess(Handle *debug, u32 processId);
+
+Result svcGetResourceLimit(Handle *resourceLimit, Handle process);
+Result svcCreateResourceLimit(Handle *resourceLimit);
+Result svcSetResourceLimitValues(Handle resourceLimit, const ResourceLimitType *names, const s64 *values, s32 nameCount);
+Result svcGetResourceLimitLimitValues(s64 *values, Handle resourceLimit, const ResourceLimitType *names, s32 nameCount);
+Result svcGetResourceLimitCurrentValues(s64 *values, Handle resourceLimit, const ResourceLimitType *names, s32 nameCount);
+Result svcSetProcessResourceLimits(Handle process, Handle resourceLimit);
+
+Result svcCreatePort(Handle *portServer, Handle *portClient, const char *name, s32 maxSessions);
+Result svcAcceptSession(Handle *session, Handle port);
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handleCount, Handle replyTarget);
+
+Result svcOutputDebugString(const char *str, s32 length);
+void svcBreak(UserBreakType breakReason);
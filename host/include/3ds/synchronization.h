@@ -0,0 +1,63 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/svc.h>
+
+// Same API as libctru, implemented with futexes in host/shim/sync.c. The layouts are the host's own.
+
+typedef s32 LightLock;
+typedef s32 CondVar;
+
+typedef struct {
+    LightLock lock;
+    u32 thread_tag;
+    u32 counter;
+} RecursiveLock;
+
+typedef struct {
+    s32 state;      ///< 1 if signalled
+    s32 resetType;
+} LightEvent;
+
+typedef struct {
+    s32 current_count;
+    s16 num_threads_acq;
+    s16 max_count;
+} LightSemaphore;
+
+void LightLock_Init(LightLock *lock);
+void LightLock_Lock(LightLock *lock);
+int LightLock_TryLock(LightLock *lock);
+void LightLock_Unlock(LightLock *lock);
+
+void RecursiveLock_Init(RecursiveLock *lock);
+void RecursiveLock_Lock(RecursiveLock *lock);
+int RecursiveLock_TryLock(RecursiveLock *lock);
+void RecursiveLock_Unlock(RecursiveLock *lock);
+
+void CondVar_Init(CondVar *cv);
+void CondVar_Wait(CondVar *cv, LightLock *lock);
+int CondVar_WaitTimeout(CondVar *cv, LightLock *lock, s64 timeout_ns);
+void CondVar_WakeUp(CondVar *cv, s32 num_threads);
+
+static inline void CondVar_Signal(CondVar *cv)
+{
+    CondVar_WakeUp(cv, 1);
+}
+
+static inline void CondVar_Broadcast(CondVar *cv)
+{
+    CondVar_WakeUp(cv, -1);
+}
+
+void LightEvent_Init(LightEvent *event, ResetType reset_type);
+void LightEvent_Clear(LightEvent *event);
+void LightEvent_Signal(LightEvent *event);
+int LightEvent_TryWait(LightEvent *event);
+void LightEvent_Wait(LightEvent *event);
+int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns);
+
+void LightSemaphore_Init(LightSemaphore *semaphore, s16 initial_count, s16 max_count);
+void LightSemaphore_Acquire(LightSemaphore *semaphore, s32 count);
+int LightSemaphore_TryAcquire(LightSemaphore *semaphore, s32 count);
+void LightSemaphore_Release(LightSemaphore *semaphore, s32 count);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/exheader.h>
+
+// Control of the simulated kernel and services of the host build (see host/Makefile)
+
+typedef enum HostService {
+    HOSTSERVICE_LOADER = 0,
+    HOSTSERVICE_FSREG,
+    HOSTSERVICE_SRVPM,
+
+    HOSTSERVICE_COUNT,
+} HostService;
+
+/// A title the simulated loader knows about
+typedef struct HostTitle {
+    u64 titleId;
+    u64 dependencies[48];
+    u32 numDependencies;
+    ResourceLimitCategory reslimitCategory;
+    s64 exitDelay;  ///< ns between termination notification 0x100 and the exit; < 0: only exits when terminated
+} HostTitle;
+
+#define HOST_SYSCOREVER 2
+
+/// Maps the shared config page (O3DS, SYSCOREVER = HOST_SYSCOREVER) and creates the KIPs (which never exit)
+void Host_Init(u32 numKips);
+
+bool Host_AddTitle(const HostTitle *title);
+/// Added to every call to the service
+void Host_SetServiceLatency(HostService service, s64 ns);
+
+/// Makes a process exit by itself (crash, etc.)
+void Host_ExitProcessAfter(u32 pid, s64 delay);
+/// Processes that haven't exited, KIPs included
+u32 Host_GetNumProcesses(void);
+/// Number of notifications published with srvPublishToSubscriber
+u32 Host_GetNumPublishedNotifications(void);
@@ -0,0 +1,168 @@
+// Runs PM against the simulated kernel and services: launches a title along with its dependencies, then terminates
+// it, a number of times. Prints the end-to-end latencies, then the statistics PM collected (what pm:dbg returns).
+//
+// Usage: pm_sim [iterations] [service latency in us] [exit delay in us]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <3ds.h>
+#include "host.h"
+
+#include "manager.h"
+#include "launch.h"
+#include "termination.h"
+#include "launch_stats.h"
+#include "termination_trace.h"
+#include "util.h"
+
+#define NUM_KIPS            5
+
+#define APPLICATION_TID     0x0004000000055D00ULL
+#define SYSMODULE_TID(n)    (0x0004013000001002ULL + ((u64)(n) << 8))
+
+void __appInit(void);
+
+// The application needs 4 sysmodules, which all need a 5th one
+static void addTitles(s64 exitDelay)
+{
+    HostTitle title = { .titleId = SYSMODULE_TID(0), .reslimitCategory = RESLIMIT_CATEGORY_OTHER, .exitDelay = exitDelay };
+    Host_AddTitle(&title);
+
+    for (u32 i = 1; i <= 4; i++) {
+        title.titleId = SYSMODULE_TID(i);
+        title.dependencies[0] = SYSMODULE_TID(0);
+        title.numDependencies = 1;
+        Host_AddTitle(&title);
+    }
+
+    title.titleId = APPLICATION_TID;
+    title.reslimitCategory = RESLIMIT_CATEGORY_APPLICATION;
+    title.numDependencies = 4;
+    for (u32 i = 0; i < 4; i++) {
+        title.dependencies[i] = SYSMODULE_TID(i + 1);
+    }
+    Host_AddTitle(&title);
+}
+
+static u32 getNumPmProcesses(void)
+{
+    ProcessData *process;
+    u32 num = 0;
+
+    ProcessList_Lock(&g_manager.processList);
+    FOREACH_PROCESS(&g_manager.processList, process) {
+        ++num;
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    return num;
+}
+
+typedef struct Latency {
+    u64 min, max, total;
+    u32 count;
+} Latency;
+
+static void addSample(Latency *latency, u64 ticks)
+{
+    latency->min = latency->count == 0 || ticks < latency->min ? ticks : latency->min;
+    latency->max = ticks > latency->max ? ticks : latency->max;
+    latency->total += ticks;
+    ++latency->count;
+}
+
+// minTicks is -1 when unknown
+static void printLatency(const char *name, u32 count, u64 minTicks, u64 maxTicks, u64 totalTicks)
+{
+    char min[16] = "-";
+
+    if (count == 0) {
+        return;
+    }
+
+    if (minTicks != (u64)-1) {
+        snprintf(min, sizeof(min), "%.1f", ticksToNs(minTicks) / 1000.0);
+    }
+    printf("  %-34s %6lu %10s %10.1f %10.1f\n", name, (unsigned long)count, min, ticksToNs(totalTicks / count) / 1000.0,
+        ticksToNs(maxTicks) / 1000.0);
+}
+
+static void printPmStats(void)
+{
+    static const char *const stageNames[LAUNCHSTAGE_COUNT] = {
+        "register program", "get program info", "load process", "fs:reg register", "srv:pm register", "dependencies", "run",
+    };
+    static const char *const categoryNames[LAUNCHCATEGORY_COUNT] = { "application", "applet", "sysmodule" };
+
+    printf("\nPM launch stages (us)                     count        min        avg        max\n");
+    for (u32 category = 0; category < LAUNCHCATEGORY_COUNT; category++) {
+        LaunchStageStats stats[LAUNCHSTAGE_COUNT];
+        LaunchStats_Get(stats, (LaunchCategory)category);
+        for (u32 stage = 0; stage < LAUNCHSTAGE_COUNT; stage++) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s: %s", categoryNames[category], stageNames[stage]);
+            printLatency(name, stats[stage].count, stats[stage].minTicks, stats[stage].maxTicks, stats[stage].totalTicks);
+        }
+    }
+
+    printf("\nPM termination trace (us)                 count        min        avg        max\n");
+    for (u32 category = 0; category < LAUNCHCATEGORY_COUNT; category++) {
+        TerminationTraceStats stats[TERMINATIONTRACE_INTERVAL_COUNT];
+        TerminationTrace_GetStats(stats, (LaunchCategory)category);
+        for (u32 interval = 0; interval < TERMINATIONTRACE_INTERVAL_COUNT; interval++) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s: %s", categoryNames[category], interval == TERMINATIONTRACE_INTERVAL_EXIT ? "notified -> exit" : "exit -> reaped");
+            printLatency(name, stats[interval].count, (u64)-1, stats[interval].maxTicks, stats[interval].totalTicks);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    u32 numIterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 50;
+    s64 serviceLatency = (argc > 2 ? strtoll(argv[2], NULL, 0) : 100) * 1000;
+    s64 exitDelay = (argc > 3 ? strtoll(argv[3], NULL, 0) : 2000) * 1000;
+
+    Host_Init(NUM_KIPS);
+    for (u32 i = 0; i < HOSTSERVICE_COUNT; i++) {
+        Host_SetServiceLatency((HostService)i, serviceLatency);
+    }
+    addTitles(exitDelay);
+    __appInit();
+
+    printf("%lu iterations, %lld us per service call, processes exit %lld us after notification 0x100\n",
+        (unsigned long)numIterations, (long long)serviceLatency / 1000, (long long)exitDelay / 1000);
+
+    Latency launch = {0}, termination = {0};
+    FS_ProgramInfo programInfo = { .programId = APPLICATION_TID, .mediaType = MEDIATYPE_NAND };
+
+    for (u32 i = 0; i < numIterations; i++) {
+        u32 pid;
+        u64 tick = svcGetSystemTick();
+        Result res = LaunchTitle(&pid, &programInfo, PMLAUNCHFLAG_LOAD_DEPENDENCIES);
+        if (R_FAILED(res)) {
+            fprintf(stderr, "LaunchTitle failed: %08lx\n", (unsigned long)res);
+            return 1;
+        }
+        addSample(&launch, svcGetSystemTick() - tick);
+
+        // Done once everything has been reaped, dependencies included
+        tick = svcGetSystemTick();
+        res = TerminateProcess(pid, 1000 * 1000 * 1000LL);
+        if (R_FAILED(res)) {
+            fprintf(stderr, "TerminateProcess failed: %08lx\n", (unsigned long)res);
+            return 1;
+        }
+        while (getNumPmProcesses() > NUM_KIPS) {
+            svcSleepThread(20 * 1000LL);
+        }
+        addSample(&termination, svcGetSystemTick() - tick);
+    }
+
+    printf("\nEnd to end (us)                           count        min        avg        max\n");
+    printLatency("launch with dependencies", launch.count, launch.min, launch.max, launch.total);
+    printLatency("termination, until reaped", termination.count, termination.min, termination.max, termination.total);
+    printPmStats();
+
+    return 0;
+}
@@ -0,0 +1,21 @@
+// libctru's startup hooks, which main.c's initSystem and __ctru_exit call. Nothing to do on the host
+
+#include <3ds.h>
+
+Result __sync_init(void)
+{
+    return 0;
+}
+
+Result __sync_fini(void)
+{
+    return 0;
+}
+
+void __libc_init_array(void)
+{
+}
+
+void __libc_fini_array(void)
+{
+}
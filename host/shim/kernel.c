@@ -0,0 +1,703 @@
+// Simulated kernel: handles, events, processes, threads and resource limits, on top of pthreads.
+// Only what PM needs is implemented, with the same waiting semantics as the real kernel (oneshot events are consumed
+// by the wait that returns them, processes are signalled when they exit).
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "kernel.h"
+#include "host.h"
+
+#define KERNEL_MAX_HANDLES      0x1000
+#define KERNEL_MAX_PROCESSES    0x400
+#define HANDLE_BASE             0x100
+
+#define RESULT_INVALID_HANDLE   ((Result)0xD8E007F7)
+#define RESULT_OUT_OF_HANDLES   ((Result)0xD8600413)
+#define RESULT_TIMEOUT          ((Result)0x09401BFE)
+#define RESULT_NOT_IMPLEMENTED  ((Result)0xF8C007F4)
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    KObject *handles[KERNEL_MAX_HANDLES];
+    KObject *processes[KERNEL_MAX_PROCESSES];
+    u32 numProcesses;
+    u32 numKips;
+    KObject *kipReslimit; ///< the KIPs', PM included
+    u32 numTlsSlots;
+} g_kernel = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// In the static data, so that the addresses fit in a u32 like on the console (the host build is linked with -no-pie)
+static u8 ALIGN(16) g_tls[KERNEL_NUM_TLS_SLOTS][0x200];
+static __thread s32 t_tlsSlot = -1;
+
+void Kernel_Lock(void)
+{
+    pthread_mutex_lock(&g_kernel.lock);
+}
+
+void Kernel_Unlock(void)
+{
+    pthread_mutex_unlock(&g_kernel.lock);
+}
+
+static u64 getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static u64 nsToTicksHost(u64 ns)
+{
+    return (u64)((unsigned __int128)ns * SYSCLOCK_ARM11 / 1000000000ULL);
+}
+
+static u64 ticksToNsHost(u64 ticks)
+{
+    return (u64)((unsigned __int128)ticks * 1000000000ULL / SYSCLOCK_ARM11);
+}
+
+void Kernel_SleepNs(s64 ns)
+{
+    if (ns <= 0) {
+        return;
+    }
+
+    struct timespec ts = { .tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+KObject *Kernel_CreateObject(KObjectType type)
+{
+    KObject *object = calloc(1, sizeof(KObject));
+    if (object == NULL) {
+        abort();
+    }
+
+    object->type = type;
+    return object;
+}
+
+static void releaseObject(KObject *object)
+{
+    if (--object->refcount > 0) {
+        return;
+    }
+
+    if (object->type == KOBJECT_PROCESS) {
+        for (u32 i = 0; i < g_kernel.numProcesses; i++) {
+            if (g_kernel.processes[i] == object) {
+                g_kernel.processes[i] = g_kernel.processes[--g_kernel.numProcesses];
+                break;
+            }
+        }
+    }
+
+    free(object);
+}
+
+Handle Kernel_CreateHandle(KObject *object)
+{
+    for (u32 i = 0; i < KERNEL_MAX_HANDLES; i++) {
+        if (g_kernel.handles[i] == NULL) {
+            g_kernel.handles[i] = object;
+            ++object->refcount;
+            return HANDLE_BASE + i;
+        }
+    }
+
+    return 0;
+}
+
+KObject *Kernel_GetObject(Handle handle, KObjectType type)
+{
+    if (handle < HANDLE_BASE || handle >= HANDLE_BASE + KERNEL_MAX_HANDLES) {
+        return NULL;
+    }
+
+    KObject *object = g_kernel.handles[handle - HANDLE_BASE];
+    return object != NULL && (type == 0 || object->type == type) ? object : NULL;
+}
+
+KObject *Kernel_CreateProcess(u32 pid, u64 titleId, s64 exitDelay)
+{
+    if (g_kernel.numProcesses >= KERNEL_MAX_PROCESSES) {
+        return NULL;
+    }
+
+    KObject *process = Kernel_CreateObject(KOBJECT_PROCESS);
+    process->pid = pid;
+    process->titleId = titleId;
+    process->exitDelay = exitDelay;
+    g_kernel.processes[g_kernel.numProcesses++] = process;
+
+    // Referenced by the process itself until it exits
+    ++process->refcount;
+    return process;
+}
+
+KObject *Kernel_FindProcessById(u32 pid)
+{
+    for (u32 i = 0; i < g_kernel.numProcesses; i++) {
+        if (g_kernel.processes[i]->pid == pid && !g_kernel.processes[i]->signalled) {
+            return g_kernel.processes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void exitProcess(KObject *process)
+{
+    if (!process->signalled) {
+        process->signalled = true;
+        process->exitTick = 0;
+        pthread_cond_broadcast(&g_kernel.changed);
+        releaseObject(process);
+    }
+}
+
+void Kernel_ScheduleExit(KObject *process, s64 delay)
+{
+    if (process->signalled || delay < 0) {
+        return;
+    }
+
+    u64 exitTick = svcGetSystemTick() + nsToTicksHost(delay);
+    if (process->exitTick == 0 || exitTick < process->exitTick) {
+        process->exitTick = exitTick;
+        // Waiters may need to wake up earlier
+        pthread_cond_broadcast(&g_kernel.changed);
+    }
+}
+
+u32 Kernel_GetNumProcesses(bool includeExited)
+{
+    u32 num = 0;
+    for (u32 i = 0; i < g_kernel.numProcesses; i++) {
+        num += includeExited || !g_kernel.processes[i]->signalled;
+    }
+
+    return num;
+}
+
+static bool isSignalled(KObject *object, u64 now)
+{
+    if (object->type == KOBJECT_PROCESS && object->exitTick != 0 && now >= object->exitTick) {
+        exitProcess(object);
+    }
+
+    return object->signalled;
+}
+
+static void consume(KObject *object)
+{
+    if (object->type == KOBJECT_EVENT && object->resetType == RESET_ONESHOT) {
+        object->signalled = false;
+    }
+}
+
+static Result waitObjects(s32 *out, const Handle *handles, s32 numHandles, bool waitAll, s64 timeout)
+{
+    KObject *objects[numHandles > 0 ? numHandles : 1];
+    u64 deadline = timeout >= 0 ? getMonotonicNs() + timeout : UINT64_MAX;
+
+    Kernel_Lock();
+    for (s32 i = 0; i < numHandles; i++) {
+        objects[i] = Kernel_GetObject(handles[i], 0);
+        if (objects[i] == NULL) {
+            Kernel_Unlock();
+            return RESULT_INVALID_HANDLE;
+        }
+    }
+
+    for (;;) {
+        u64 now = svcGetSystemTick();
+        u64 wakeTick = UINT64_MAX;
+        s32 numSignalled = 0, firstSignalled = -1;
+
+        for (s32 i = 0; i < numHandles; i++) {
+            if (isSignalled(objects[i], now)) {
+                firstSignalled = firstSignalled < 0 ? i : firstSignalled;
+                ++numSignalled;
+            } else if (objects[i]->type == KOBJECT_PROCESS && objects[i]->exitTick != 0 && objects[i]->exitTick < wakeTick) {
+                wakeTick = objects[i]->exitTick;
+            }
+        }
+
+        if (waitAll ? numSignalled == numHandles : numSignalled > 0) {
+            for (s32 i = 0; i < numHandles; i++) {
+                if (waitAll || i == firstSignalled) {
+                    consume(objects[i]);
+                }
+            }
+            *out = waitAll ? 0 : firstSignalled;
+            Kernel_Unlock();
+            return 0;
+        }
+
+        u64 nowNs = getMonotonicNs();
+        if (nowNs >= deadline) {
+            Kernel_Unlock();
+            return RESULT_TIMEOUT;
+        }
+
+        u64 wakeNs = wakeTick != UINT64_MAX ? ticksToNsHost(wakeTick) + 1 : UINT64_MAX;
+        u64 until = wakeNs < deadline ? wakeNs : deadline;
+        if (until == UINT64_MAX) {
+            pthread_cond_wait(&g_kernel.changed, &g_kernel.lock);
+        } else {
+            struct timespec ts = { .tv_sec = until / 1000000000ULL, .tv_nsec = until % 1000000000ULL };
+            pthread_cond_timedwait(&g_kernel.changed, &g_kernel.lock, &ts);
+        }
+    }
+}
+
+void Kernel_Init(u32 numKips)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_kernel.changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // Roomy, PM sizes its process pool from it
+    Kernel_Lock();
+    g_kernel.kipReslimit = Kernel_CreateObject(KOBJECT_RESLIMIT);
+    g_kernel.kipReslimit->refcount = 1;
+    g_kernel.kipReslimit->limitValues[RESLIMIT_COMMIT] = 0x1000000;
+    g_kernel.kipReslimit->limitValues[RESLIMIT_THREAD] = 0x80;
+
+    // The KIPs never exit
+    g_kernel.numKips = numKips;
+    for (u32 pid = 0; pid < numKips; pid++) {
+        Kernel_CreateProcess(pid, 0x0004000100001000ULL, -1);
+    }
+    Kernel_Unlock();
+}
+
+void Host_ExitProcessAfter(u32 pid, s64 delay)
+{
+    Kernel_Lock();
+    KObject *process = Kernel_FindProcessById(pid);
+    if (process != NULL) {
+        Kernel_ScheduleExit(process, delay);
+    }
+    Kernel_Unlock();
+}
+
+u32 Host_GetNumProcesses(void)
+{
+    Kernel_Lock();
+    u32 num = Kernel_GetNumProcesses(false);
+    Kernel_Unlock();
+
+    return num;
+}
+
+void *getThreadLocalStorage(void)
+{
+    if (t_tlsSlot < 0) {
+        t_tlsSlot = (s32)__atomic_fetch_add(&g_kernel.numTlsSlots, 1, __ATOMIC_RELAXED);
+        if (t_tlsSlot >= KERNEL_NUM_TLS_SLOTS) {
+            fprintf(stderr, "host: too many threads\n");
+            abort();
+        }
+    }
+
+    return g_tls[t_tlsSlot];
+}
+
+u32 *getThreadCommandBuffer(void)
+{
+    return (u32 *)((u8 *)getThreadLocalStorage() + 0x80);
+}
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr1;
+    (void)perm;
+
+    if ((op & 0xFF) != MEMOP_ALLOC) {
+        return RESULT_NOT_IMPLEMENTED;
+    }
+
+    void *addr = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (addr == MAP_FAILED || (uintptr_t)addr != addr0) {
+        return (Result)0xD8601BF8;
+    }
+
+    *addr_out = addr0;
+    return 0;
+}
+
+void svcExitProcess(void)
+{
+    exit(0);
+}
+
+typedef struct ThreadStart {
+    ThreadFunc entrypoint;
+    u32 arg;
+    KObject *thread;
+} ThreadStart;
+
+static __thread KObject *t_currentThread;
+
+static void *threadBegin(void *p)
+{
+    ThreadStart start = *(ThreadStart *)p;
+    free(p);
+
+    t_currentThread = start.thread;
+    start.entrypoint((void *)(uintptr_t)start.arg);
+    svcExitThread();
+}
+
+Result svcCreateThread(Handle *thread, ThreadFunc entrypoint, u32 arg, u32 *stack_top, s32 thread_priority, s32 processor_id)
+{
+    // The host stack is used instead
+    (void)stack_top;
+    (void)thread_priority;
+    (void)processor_id;
+
+    ThreadStart *start = malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        abort();
+    }
+
+    Kernel_Lock();
+    KObject *object = Kernel_CreateObject(KOBJECT_THREAD);
+    object->refcount = 1; // held by the thread itself
+    *thread = Kernel_CreateHandle(object);
+    Kernel_Unlock();
+
+    start->entrypoint = entrypoint;
+    start->arg = arg;
+    start->thread = object;
+
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&t, &attr, threadBegin, start);
+    pthread_attr_destroy(&attr);
+
+    return err == 0 ? 0 : (Result)0xC860180A;
+}
+
+void svcExitThread(void)
+{
+    if (t_currentThread != NULL) {
+        Kernel_Lock();
+        t_currentThread->signalled = true;
+        pthread_cond_broadcast(&g_kernel.changed);
+        releaseObject(t_currentThread);
+        Kernel_Unlock();
+    }
+
+    pthread_exit(NULL);
+}
+
+void svcSleepThread(s64 ns)
+{
+    Kernel_SleepNs(ns);
+}
+
+Result svcCreateEvent(Handle *event, ResetType reset_type)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_CreateObject(KOBJECT_EVENT);
+    object->resetType = reset_type;
+    *event = Kernel_CreateHandle(object);
+    Kernel_Unlock();
+
+    return *event != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcSignalEvent(Handle handle)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(handle, KOBJECT_EVENT);
+    if (object != NULL) {
+        object->signalled = true;
+        pthread_cond_broadcast(&g_kernel.changed);
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcClearEvent(Handle handle)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(handle, KOBJECT_EVENT);
+    if (object != NULL) {
+        object->signalled = false;
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(handle, 0);
+    if (object != NULL) {
+        g_kernel.handles[handle - HANDLE_BASE] = NULL;
+        releaseObject(object);
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcDuplicateHandle(Handle *out, Handle original)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(original, 0);
+    *out = object != NULL ? Kernel_CreateHandle(object) : 0;
+    Kernel_Unlock();
+
+    return object == NULL ? RESULT_INVALID_HANDLE : *out != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+    s32 id;
+    return waitObjects(&id, &handle, 1, false, nanoseconds);
+}
+
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds)
+{
+    return waitObjects(out, handles, handles_num, wait_all, nanoseconds);
+}
+
+u64 svcGetSystemTick(void)
+{
+    return nsToTicksHost(getMonotonicNs());
+}
+
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param)
+{
+    (void)param;
+
+    // 26: number of KIPs
+    *out = type == 26 ? g_kernel.numKips : 0;
+    return 0;
+}
+
+Result svcKernelSetState(u32 type, ...)
+{
+    va_list args;
+    Result res = 0;
+
+    // 3: map the firmlaunch parameters page. The others (firmlaunch, reboot...) aren't simulated
+    va_start(args, type);
+    if (type == 3) {
+        (void)va_arg(args, u32);
+        void *addr = va_arg(args, void *);
+        if (mmap(addr, 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != addr) {
+            res = (Result)0xD8601BF8;
+        }
+    }
+    va_end(args);
+
+    return res;
+}
+
+Result svcOpenProcess(Handle *process, u32 processId)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_FindProcessById(processId);
+    *process = object != NULL ? Kernel_CreateHandle(object) : 0;
+    Kernel_Unlock();
+
+    return object == NULL ? (Result)0xD9001818 : *process != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcGetProcessId(u32 *out, Handle handle)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(handle, KOBJECT_PROCESS);
+    if (object != NULL) {
+        *out = object->pid;
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcTerminateProcess(Handle process)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(process, KOBJECT_PROCESS);
+    if (object != NULL) {
+        exitProcess(object);
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcRun(Handle process, const StartupInfo *info)
+{
+    (void)info;
+
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(process, KOBJECT_PROCESS);
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcSetProcessAffinityMask(Handle process, const u8 *affinitymask, s32 processorcount)
+{
+    (void)process;
+    (void)affinitymask;
+    (void)processorcount;
+    return 0;
+}
+
+Result svcSetProcessIdealProcessor(Handle process, s32 processorid)
+{
+    (void)process;
+    (void)processorid;
+    return 0;
+}
+
+Result svcDebugActiveProcess(Handle *debug, u32 processId)
+{
+    Kernel_Lock();
+    KObject *process = Kernel_FindProcessById(processId);
+    *debug = process != NULL ? Kernel_CreateHandle(Kernel_CreateObject(KOBJECT_DEBUG)) : 0;
+    Kernel_Unlock();
+
+    return process == NULL ? (Result)0xD9001818 : *debug != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcGetResourceLimit(Handle *resourceLimit, Handle process)
+{
+    // Only PM's own
+    if (process != CUR_PROCESS_HANDLE) {
+        return RESULT_NOT_IMPLEMENTED;
+    }
+
+    Kernel_Lock();
+    *resourceLimit = Kernel_CreateHandle(g_kernel.kipReslimit);
+    Kernel_Unlock();
+
+    return *resourceLimit != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcCreateResourceLimit(Handle *resourceLimit)
+{
+    Kernel_Lock();
+    *resourceLimit = Kernel_CreateHandle(Kernel_CreateObject(KOBJECT_RESLIMIT));
+    Kernel_Unlock();
+
+    return *resourceLimit != 0 ? 0 : RESULT_OUT_OF_HANDLES;
+}
+
+Result svcSetResourceLimitValues(Handle resourceLimit, const ResourceLimitType *names, const s64 *values, s32 nameCount)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(resourceLimit, KOBJECT_RESLIMIT);
+    for (s32 i = 0; object != NULL && i < nameCount; i++) {
+        object->limitValues[names[i] & 0xF] = values[i];
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcGetResourceLimitLimitValues(s64 *values, Handle resourceLimit, const ResourceLimitType *names, s32 nameCount)
+{
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(resourceLimit, KOBJECT_RESLIMIT);
+    for (s32 i = 0; object != NULL && i < nameCount; i++) {
+        values[i] = object->limitValues[names[i] & 0xF];
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcGetResourceLimitCurrentValues(s64 *values, Handle resourceLimit, const ResourceLimitType *names, s32 nameCount)
+{
+    // Nothing is accounted: everything is always available
+    (void)names;
+
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(resourceLimit, KOBJECT_RESLIMIT);
+    for (s32 i = 0; object != NULL && i < nameCount; i++) {
+        values[i] = 0;
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcSetProcessResourceLimits(Handle process, Handle resourceLimit)
+{
+    Kernel_Lock();
+    bool valid = Kernel_GetObject(process, KOBJECT_PROCESS) != NULL && Kernel_GetObject(resourceLimit, KOBJECT_RESLIMIT) != NULL;
+    Kernel_Unlock();
+
+    return valid ? 0 : RESULT_INVALID_HANDLE;
+}
+
+Result svcCreatePort(Handle *portServer, Handle *portClient, const char *name, s32 maxSessions)
+{
+    (void)name;
+    (void)maxSessions;
+
+    // Nothing ever connects to the simulated ports
+    Kernel_Lock();
+    KObject *object = Kernel_CreateObject(KOBJECT_PORT);
+    *portServer = Kernel_CreateHandle(object);
+    *portClient = Kernel_CreateHandle(object);
+    Kernel_Unlock();
+
+    return 0;
+}
+
+Result svcAcceptSession(Handle *session, Handle port)
+{
+    (void)session;
+    (void)port;
+    return RESULT_NOT_IMPLEMENTED;
+}
+
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handleCount, Handle replyTarget)
+{
+    // No session is ever accepted, so there is no one to reply to: only the waiting part is simulated
+    (void)replyTarget;
+    return waitObjects(index, handles, handleCount, false, -1);
+}
+
+Result svcOutputDebugString(const char *str, s32 length)
+{
+    fprintf(stderr, "%.*s\n", (int)length, str);
+    return 0;
+}
+
+void svcBreak(UserBreakType breakReason)
+{
+    fprintf(stderr, "host: svcBreak(%d)\n", (int)breakReason);
+    abort();
+}
+
+u32 osGetFirmVersion(void)
+{
+    return SYSTEM_VERSION(2, 58, 0);
+}
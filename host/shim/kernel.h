@@ -0,0 +1,46 @@
+#pragma once
+
+#include <3ds.h>
+
+// Objects of the simulated kernel, shared with the simulated services. Everything here needs the kernel lock.
+
+typedef enum KObjectType {
+    KOBJECT_EVENT = 1,
+    KOBJECT_THREAD,
+    KOBJECT_PROCESS,
+    KOBJECT_RESLIMIT,
+    KOBJECT_PORT,
+    KOBJECT_DEBUG,
+} KObjectType;
+
+typedef struct KObject {
+    KObjectType type;
+    u32 refcount;
+    bool signalled;
+    ResetType resetType;    ///< events
+    u32 pid;                ///< processes
+    u64 titleId;
+    s64 exitDelay;          ///< delay between notification 0x100 and the exit, in ns. < 0: only exits when terminated
+    u64 exitTick;           ///< when the process exits on its own, 0 if not scheduled
+    s64 limitValues[10];    ///< resource limits
+} KObject;
+
+#define KERNEL_NUM_TLS_SLOTS    64
+
+void Kernel_Init(u32 numKips);
+void Kernel_Lock(void);
+void Kernel_Unlock(void);
+
+/// Returns NULL if the handle is invalid or of another type
+KObject *Kernel_GetObject(Handle handle, KObjectType type);
+/// Takes a reference to the object. Returns 0 if out of handles
+Handle Kernel_CreateHandle(KObject *object);
+KObject *Kernel_CreateObject(KObjectType type);
+
+/// Processes created by the simulated loader, or the KIPs
+KObject *Kernel_CreateProcess(u32 pid, u64 titleId, s64 exitDelay);
+KObject *Kernel_FindProcessById(u32 pid);
+void Kernel_ScheduleExit(KObject *process, s64 delay);
+u32 Kernel_GetNumProcesses(bool includeExited);
+
+void Kernel_SleepNs(s64 ns);
@@ -0,0 +1,318 @@
+// Simulated srv, srv:pm, Loader and fs:reg: a scripted set of titles, and a configurable latency per service
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "kernel.h"
+#include "host.h"
+
+#define HOST_MAX_TITLES     64
+#define HOST_MAX_PROGRAMS   64
+#define PROGRAMHANDLE_BASE  0x1000
+#define FIRST_PID           0x20
+
+#define RESULT_TITLE_NOT_FOUND      ((Result)0xC8804478)
+#define RESULT_INVALID_PROGRAM      ((Result)0xD9004001)
+
+static struct {
+    HostTitle titles[HOST_MAX_TITLES];
+    u32 numTitles;
+    s32 programs[HOST_MAX_PROGRAMS]; ///< registered program -> title, -1 if unused
+    u32 nextPid;
+    s64 latencies[HOSTSERVICE_COUNT];
+    u32 numPublishedNotifications;
+    Handle sessionHandles[HOSTSERVICE_COUNT];
+} g_host;
+
+void Host_Init(u32 numKips)
+{
+    // Shared config page (SYSCOREVER, APPMEMTYPE...), at its address on the console
+    void *page = mmap((void *)0x1FF80000, 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (page != (void *)0x1FF80000) {
+        fprintf(stderr, "host: couldn't map the shared config page\n");
+        abort();
+    }
+
+    *(vu32 *)0x1FF80010 = HOST_SYSCOREVER;
+    *(vu32 *)0x1FF80030 = 0;            // APPMEMTYPE: O3DS, 64MB
+    *(vu32 *)0x1FF80040 = 0x4000000;    // APPMEMALLOC
+    *(vu32 *)0x1FF80044 = 0x2C00000;    // SYSMEMALLOC
+
+    memset(g_host.programs, -1, sizeof(g_host.programs));
+    g_host.nextPid = FIRST_PID > numKips ? FIRST_PID : numKips;
+    Kernel_Init(numKips);
+}
+
+bool Host_AddTitle(const HostTitle *title)
+{
+    Kernel_Lock();
+    bool added = g_host.numTitles < HOST_MAX_TITLES;
+    if (added) {
+        g_host.titles[g_host.numTitles++] = *title;
+    }
+    Kernel_Unlock();
+
+    return added;
+}
+
+void Host_SetServiceLatency(HostService service, s64 ns)
+{
+    g_host.latencies[service] = ns;
+}
+
+u32 Host_GetNumPublishedNotifications(void)
+{
+    return __atomic_load_n(&g_host.numPublishedNotifications, __ATOMIC_RELAXED);
+}
+
+// Like on the console, each service has a single server thread: concurrent requests, whether they come from the
+// same session or not, are handled one after the other
+static pthread_mutex_t g_serverThreads[HOSTSERVICE_COUNT] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+};
+
+static inline void simulateLatency(HostService service)
+{
+    pthread_mutex_lock(&g_serverThreads[service]);
+    Kernel_SleepNs(g_host.latencies[service]);
+    pthread_mutex_unlock(&g_serverThreads[service]);
+}
+
+// Needs the kernel lock
+static const HostTitle *getProgramTitle(u64 programHandle)
+{
+    u64 id = programHandle - PROGRAMHANDLE_BASE;
+    return id < HOST_MAX_PROGRAMS && g_host.programs[id] >= 0 ? &g_host.titles[g_host.programs[id]] : NULL;
+}
+
+// srv
+Result srvEnableNotification(Handle *semaphoreOut)
+{
+    // Nothing is ever published to PM
+    return svcCreateEvent(semaphoreOut, RESET_ONESHOT);
+}
+
+Result srvSubscribe(u32 notificationId)
+{
+    (void)notificationId;
+    return 0;
+}
+
+Result srvUnsubscribe(u32 notificationId)
+{
+    (void)notificationId;
+    return 0;
+}
+
+Result srvReceiveNotification(u32 *notificationIdOut)
+{
+    *notificationIdOut = 0;
+    return 0;
+}
+
+Result srvPublishToSubscriber(u32 notificationId, u32 flags)
+{
+    (void)notificationId;
+    (void)flags;
+
+    __atomic_add_fetch(&g_host.numPublishedNotifications, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+Result srvRegisterService(Handle *out, const char *name, int maxSessions)
+{
+    Handle client;
+    Result res = svcCreatePort(out, &client, name, maxSessions);
+    if (R_SUCCEEDED(res)) {
+        svcCloseHandle(client);
+    }
+
+    return res;
+}
+
+Result srvUnregisterService(const char *name)
+{
+    (void)name;
+    return 0;
+}
+
+// srv:pm
+Result srvPmInit(void)
+{
+    return 0;
+}
+
+void srvPmExit(void)
+{
+}
+
+Handle *srvPmGetSessionHandle(void)
+{
+    return &g_host.sessionHandles[HOSTSERVICE_SRVPM];
+}
+
+Result SRVPM_PublishToProcess(u32 notificationId, Handle process)
+{
+    simulateLatency(HOSTSERVICE_SRVPM);
+
+    Kernel_Lock();
+    KObject *object = Kernel_GetObject(process, KOBJECT_PROCESS);
+    if (object != NULL && notificationId == 0x100) {
+        // Termination notification: the process exits once it's done cleaning up
+        Kernel_ScheduleExit(object, object->exitDelay);
+    }
+    Kernel_Unlock();
+
+    return object != NULL ? 0 : (Result)0xD8E007F7;
+}
+
+Result SRVPM_PublishToAll(u32 notificationId)
+{
+    (void)notificationId;
+    simulateLatency(HOSTSERVICE_SRVPM);
+    return 0;
+}
+
+Result SRVPM_RegisterProcess(u32 pid, u32 count, const char (*serviceAccessControlList)[8])
+{
+    (void)pid;
+    (void)count;
+    (void)serviceAccessControlList;
+    simulateLatency(HOSTSERVICE_SRVPM);
+    return 0;
+}
+
+Result SRVPM_UnregisterProcess(u32 pid)
+{
+    (void)pid;
+    simulateLatency(HOSTSERVICE_SRVPM);
+    return 0;
+}
+
+// Loader
+Result loaderInit(void)
+{
+    return 0;
+}
+
+void loaderExit(void)
+{
+}
+
+Handle *loaderGetSessionHandle(void)
+{
+    return &g_host.sessionHandles[HOSTSERVICE_LOADER];
+}
+
+Result LOADER_RegisterProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate)
+{
+    (void)programInfoUpdate;
+    simulateLatency(HOSTSERVICE_LOADER);
+
+    Result res = RESULT_TITLE_NOT_FOUND;
+    Kernel_Lock();
+    for (u32 i = 0; i < g_host.numTitles; i++) {
+        if (g_host.titles[i].titleId == programInfo->programId) {
+            res = (Result)0xD8A04003; // out of program slots
+            for (u32 id = 0; id < HOST_MAX_PROGRAMS; id++) {
+                if (g_host.programs[id] < 0) {
+                    g_host.programs[id] = (s32)i;
+                    *programHandle = PROGRAMHANDLE_BASE + id;
+                    res = 0;
+                    break;
+                }
+            }
+            break;
+        }
+    }
+    Kernel_Unlock();
+
+    return res;
+}
+
+Result LOADER_UnregisterProgram(u64 programHandle)
+{
+    simulateLatency(HOSTSERVICE_LOADER);
+
+    Kernel_Lock();
+    bool valid = getProgramTitle(programHandle) != NULL;
+    if (valid) {
+        g_host.programs[programHandle - PROGRAMHANDLE_BASE] = -1;
+    }
+    Kernel_Unlock();
+
+    return valid ? 0 : RESULT_INVALID_PROGRAM;
+}
+
+Result LOADER_GetProgramInfo(ExHeader_Info *exheaderInfo, u64 programHandle)
+{
+    simulateLatency(HOSTSERVICE_LOADER);
+
+    Kernel_Lock();
+    const HostTitle *title = getProgramTitle(programHandle);
+    if (title != NULL) {
+        memset(exheaderInfo, 0, sizeof(ExHeader_Info));
+        memcpy(exheaderInfo->sci.dependencies, title->dependencies, title->numDependencies * sizeof(u64));
+        exheaderInfo->sci.codeset_info.stack_size = 0x1000;
+        exheaderInfo->aci.local_caps.title_id = title->titleId;
+        exheaderInfo->aci.local_caps.core_info.core_version = HOST_SYSCOREVER;
+        exheaderInfo->aci.local_caps.core_info.affinity_mask = 1;
+        exheaderInfo->aci.local_caps.core_info.priority = 0x30;
+        exheaderInfo->aci.local_caps.reslimit_category = title->reslimitCategory;
+    }
+    Kernel_Unlock();
+
+    return title != NULL ? 0 : RESULT_INVALID_PROGRAM;
+}
+
+Result LOADER_LoadProcess(Handle *process, u64 programHandle)
+{
+    simulateLatency(HOSTSERVICE_LOADER);
+
+    Result res = RESULT_INVALID_PROGRAM;
+    Kernel_Lock();
+    const HostTitle *title = getProgramTitle(programHandle);
+    if (title != NULL) {
+        KObject *object = Kernel_CreateProcess(g_host.nextPid++, title->titleId, title->exitDelay);
+        *process = object != NULL ? Kernel_CreateHandle(object) : 0;
+        res = *process != 0 ? 0 : (Result)0xD8600413;
+    }
+    Kernel_Unlock();
+
+    return res;
+}
+
+// fs:reg
+Result fsRegInit(void)
+{
+    return 0;
+}
+
+void fsRegExit(void)
+{
+}
+
+Handle *fsRegGetSessionHandle(void)
+{
+    return &g_host.sessionHandles[HOSTSERVICE_FSREG];
+}
+
+Result FSREG_Register(u32 pid, u64 prog_handle, const FS_ProgramInfo *info, const ExHeader_Arm11StorageInfo *storageinfo)
+{
+    (void)pid;
+    (void)prog_handle;
+    (void)info;
+    (void)storageinfo;
+    simulateLatency(HOSTSERVICE_FSREG);
+    return 0;
+}
+
+Result FSREG_Unregister(u32 pid)
+{
+    (void)pid;
+    simulateLatency(HOSTSERVICE_FSREG);
+    return 0;
+}
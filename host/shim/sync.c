@@ -0,0 +1,240 @@
+// libctru's light synchronization primitives, on top of futexes
+
+#define _GNU_SOURCE
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <3ds.h>
+
+static int futexWait(s32 *addr, s32 value, s64 timeout)
+{
+    struct timespec ts = { .tv_sec = timeout / 1000000000LL, .tv_nsec = timeout % 1000000000LL };
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout >= 0 ? &ts : NULL, NULL, 0) == 0 ? 0 : errno;
+}
+
+static void futexWake(s32 *addr, s32 count)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count < 0 ? INT_MAX : count, NULL, NULL, 0);
+}
+
+static s64 getRemainingNs(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec);
+}
+
+static struct timespec getDeadline(s64 timeout)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout / 1000000000LL + (ts.tv_nsec + timeout % 1000000000LL) / 1000000000LL;
+    ts.tv_nsec = (ts.tv_nsec + timeout % 1000000000LL) % 1000000000LL;
+    return ts;
+}
+
+// 0: unlocked, 1: locked, 2: locked with waiters
+void LightLock_Init(LightLock *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+void LightLock_Lock(LightLock *lock)
+{
+    s32 c = 0;
+    if (__atomic_compare_exchange_n(lock, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    if (c != 2) {
+        c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+    }
+    while (c != 0) {
+        futexWait(lock, 2, -1);
+        c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+int LightLock_TryLock(LightLock *lock)
+{
+    s32 c = 0;
+    return __atomic_compare_exchange_n(lock, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ? 0 : 1;
+}
+
+void LightLock_Unlock(LightLock *lock)
+{
+    if (__atomic_exchange_n(lock, 0, __ATOMIC_RELEASE) == 2) {
+        futexWake(lock, 1);
+    }
+}
+
+void RecursiveLock_Init(RecursiveLock *lock)
+{
+    LightLock_Init(&lock->lock);
+    lock->thread_tag = 0;
+    lock->counter = 0;
+}
+
+void RecursiveLock_Lock(RecursiveLock *lock)
+{
+    u32 tag = (u32)(uintptr_t)getThreadLocalStorage();
+    if (lock->thread_tag != tag) {
+        LightLock_Lock(&lock->lock);
+        lock->thread_tag = tag;
+    }
+    ++lock->counter;
+}
+
+int RecursiveLock_TryLock(RecursiveLock *lock)
+{
+    u32 tag = (u32)(uintptr_t)getThreadLocalStorage();
+    if (lock->thread_tag != tag) {
+        if (LightLock_TryLock(&lock->lock) != 0) {
+            return 1;
+        }
+        lock->thread_tag = tag;
+    }
+    ++lock->counter;
+    return 0;
+}
+
+void RecursiveLock_Unlock(RecursiveLock *lock)
+{
+    if (--lock->counter == 0) {
+        lock->thread_tag = 0;
+        LightLock_Unlock(&lock->lock);
+    }
+}
+
+// Low 16 bits: number of waiters, high 16 bits: sequence number, incremented by each wake up. Like libctru, waking
+// up a condition variable nobody waits on doesn't make a syscall. Spurious wake ups are allowed, as with libctru
+#define CONDVAR_WAITER      1
+#define CONDVAR_WAITERS     0xFFFF
+#define CONDVAR_SEQ         0x10000
+
+void CondVar_Init(CondVar *cv)
+{
+    __atomic_store_n(cv, 0, __ATOMIC_RELEASE);
+}
+
+static int condVarWait(CondVar *cv, LightLock *lock, s64 timeout_ns)
+{
+    s32 value = __atomic_add_fetch(cv, CONDVAR_WAITER, __ATOMIC_ACQ_REL);
+    LightLock_Unlock(lock);
+    int err = futexWait(cv, value, timeout_ns);
+    __atomic_sub_fetch(cv, CONDVAR_WAITER, __ATOMIC_ACQ_REL);
+    LightLock_Lock(lock);
+
+    return err;
+}
+
+void CondVar_Wait(CondVar *cv, LightLock *lock)
+{
+    condVarWait(cv, lock, -1);
+}
+
+int CondVar_WaitTimeout(CondVar *cv, LightLock *lock, s64 timeout_ns)
+{
+    return condVarWait(cv, lock, timeout_ns > 0 ? timeout_ns : 0) == ETIMEDOUT ? 1 : 0;
+}
+
+void CondVar_WakeUp(CondVar *cv, s32 num_threads)
+{
+    if ((__atomic_load_n(cv, __ATOMIC_ACQUIRE) & CONDVAR_WAITERS) == 0) {
+        return;
+    }
+
+    __atomic_add_fetch(cv, CONDVAR_SEQ, __ATOMIC_RELEASE);
+    futexWake(cv, num_threads);
+}
+
+void LightEvent_Init(LightEvent *event, ResetType reset_type)
+{
+    event->resetType = reset_type;
+    __atomic_store_n(&event->state, 0, __ATOMIC_RELEASE);
+}
+
+void LightEvent_Clear(LightEvent *event)
+{
+    __atomic_store_n(&event->state, 0, __ATOMIC_RELEASE);
+}
+
+void LightEvent_Signal(LightEvent *event)
+{
+    __atomic_store_n(&event->state, 1, __ATOMIC_RELEASE);
+    futexWake(&event->state, event->resetType == RESET_ONESHOT ? 1 : -1);
+}
+
+int LightEvent_TryWait(LightEvent *event)
+{
+    if (event->resetType == RESET_ONESHOT) {
+        s32 expected = 1;
+        return __atomic_compare_exchange_n(&event->state, &expected, 0, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+
+    return __atomic_load_n(&event->state, __ATOMIC_ACQUIRE) == 1;
+}
+
+void LightEvent_Wait(LightEvent *event)
+{
+    while (!LightEvent_TryWait(event)) {
+        futexWait(&event->state, 0, -1);
+    }
+}
+
+int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns)
+{
+    struct timespec deadline = getDeadline(timeout_ns);
+
+    while (!LightEvent_TryWait(event)) {
+        s64 remaining = getRemainingNs(&deadline);
+        if (remaining <= 0) {
+            return 1;
+        }
+        futexWait(&event->state, 0, remaining);
+    }
+
+    return 0;
+}
+
+void LightSemaphore_Init(LightSemaphore *semaphore, s16 initial_count, s16 max_count)
+{
+    semaphore->num_threads_acq = 0;
+    semaphore->max_count = max_count;
+    __atomic_store_n(&semaphore->current_count, initial_count, __ATOMIC_RELEASE);
+}
+
+void LightSemaphore_Acquire(LightSemaphore *semaphore, s32 count)
+{
+    for (;;) {
+        s32 current = __atomic_load_n(&semaphore->current_count, __ATOMIC_ACQUIRE);
+        if (current >= count) {
+            if (__atomic_compare_exchange_n(&semaphore->current_count, &current, current - count, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+        } else {
+            futexWait(&semaphore->current_count, current, -1);
+        }
+    }
+}
+
+int LightSemaphore_TryAcquire(LightSemaphore *semaphore, s32 count)
+{
+    s32 current = __atomic_load_n(&semaphore->current_count, __ATOMIC_ACQUIRE);
+    while (current >= count) {
+        if (__atomic_compare_exchange_n(&semaphore->current_count, &current, current - count, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void LightSemaphore_Release(LightSemaphore *semaphore, s32 count)
+{
+    __atomic_add_fetch(&semaphore->current_count, count, __ATOMIC_RELEASE);
+    futexWake(&semaphore->current_count, -1);
+}
@@ -0,0 +1,173 @@
+#include <3ds.h>
+#include <string.h>
+#include "exit_stats.h"
+#include "util.h"
+
+typedef struct ExitStatsEntry {
+    u64 titleId;
+    u64 averageTicks;
+    u32 lastUsed; ///< 0: unused entry
+    u16 numSamples;
+    u16 numCensored;
+    u8 buckets[EXITSTATS_NUM_BUCKETS];
+} ExitStatsEntry;
+
+static struct {
+    LightLock lock;
+    u32 clock;
+    bool adaptive;
+    ExitStatsEntry entries[EXITSTATS_NUM_ENTRIES];
+} g_exitStats;
+
+void ExitStats_Init(void)
+{
+    memset(&g_exitStats, 0, sizeof(g_exitStats));
+    LightLock_Init(&g_exitStats.lock);
+}
+
+void ExitStats_SetAdaptive(bool adaptive)
+{
+    g_exitStats.adaptive = adaptive;
+}
+
+bool ExitStats_IsAdaptive(void)
+{
+    return g_exitStats.adaptive;
+}
+
+static u32 tick(void)
+{
+    if (++g_exitStats.clock == 0) {
+        for (u32 i = 0; i < EXITSTATS_NUM_ENTRIES; i++) {
+            if (g_exitStats.entries[i].lastUsed != 0) {
+                g_exitStats.entries[i].lastUsed = 1;
+            }
+        }
+        g_exitStats.clock = 2;
+    }
+
+    return g_exitStats.clock;
+}
+
+static ExitStatsEntry *findEntry(u64 titleId)
+{
+    for (u32 i = 0; i < EXITSTATS_NUM_ENTRIES; i++) {
+        ExitStatsEntry *entry = &g_exitStats.entries[i];
+        if (entry->lastUsed != 0 && entry->titleId == titleId) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static u64 getP95Ticks(const ExitStatsEntry *entry)
+{
+    u32 total = 0, count = 0, i;
+    for (i = 0; i < EXITSTATS_NUM_BUCKETS; i++) {
+        total += entry->buckets[i];
+    }
+
+    u32 threshold = total - total / 20;
+    for (i = 0; i < EXITSTATS_NUM_BUCKETS - 1; i++) {
+        count += entry->buckets[i];
+        if (count >= threshold) {
+            break;
+        }
+    }
+
+    return 1ULL << (i + 1 + EXITSTATS_BUCKET_SHIFT);
+}
+
+// A censored sample is a lower bound: the process was killed after ticks, without having exited
+static void addSample(u64 titleId, u64 ticks, bool censored)
+{
+    ExitStatsEntry *entry = findEntry(titleId);
+    if (entry == NULL) {
+        // Replace the least recently used entry
+        entry = &g_exitStats.entries[0];
+        for (u32 i = 1; i < EXITSTATS_NUM_ENTRIES && entry->lastUsed != 0; i++) {
+            if (g_exitStats.entries[i].lastUsed < entry->lastUsed) {
+                entry = &g_exitStats.entries[i];
+            }
+        }
+
+        memset(entry, 0, sizeof(ExitStatsEntry));
+        entry->titleId = titleId;
+        entry->averageTicks = ticks;
+    } else if (!censored || ticks > entry->averageTicks) {
+        entry->averageTicks = entry->averageTicks - (entry->averageTicks >> 3) + (ticks >> 3);
+    }
+
+    // The real latency of a censored sample is past the deadline: it's charged to the next bucket
+    u64 units = ticks >> EXITSTATS_BUCKET_SHIFT;
+    u32 bucket = (units == 0 ? 0 : 63 - __builtin_clzll(units)) + (censored ? 1 : 0);
+    bucket = bucket >= EXITSTATS_NUM_BUCKETS ? EXITSTATS_NUM_BUCKETS - 1 : bucket;
+
+    if (entry->buckets[bucket] == 0xFF) {
+        // Halve everything, this also makes older samples matter less
+        for (u32 i = 0; i < EXITSTATS_NUM_BUCKETS; i++) {
+            entry->buckets[i] >>= 1;
+        }
+    }
+    ++entry->buckets[bucket];
+
+    if (entry->numSamples < 0xFFFF) {
+        ++entry->numSamples;
+    }
+    if (censored && entry->numCensored < 0xFFFF) {
+        ++entry->numCensored;
+    }
+    entry->lastUsed = tick();
+}
+
+void ExitStats_Record(u64 titleId, u64 ticks)
+{
+    LightLock_Lock(&g_exitStats.lock);
+    addSample(titleId, ticks, false);
+    LightLock_Unlock(&g_exitStats.lock);
+}
+
+void ExitStats_RecordCensored(u64 titleId, u64 ticks)
+{
+    LightLock_Lock(&g_exitStats.lock);
+    addSample(titleId, ticks, true);
+    LightLock_Unlock(&g_exitStats.lock);
+}
+
+s64 ExitStats_GetAdaptiveTimeout(u64 titleId)
+{
+    s64 timeout = -1;
+
+    if (!g_exitStats.adaptive) {
+        return -1;
+    }
+
+    LightLock_Lock(&g_exitStats.lock);
+    ExitStatsEntry *entry = findEntry(titleId);
+    if (entry != NULL && entry->numSamples >= EXITSTATS_MIN_SAMPLES) {
+        // Twice the usual worst case, so that a well-behaved process isn't killed just for being a bit slow once
+        u64 p95 = getP95Ticks(entry);
+        u64 learned = 2 * (p95 > entry->averageTicks ? p95 : entry->averageTicks);
+        s64 minTimeout = nsToTicks(EXITSTATS_MIN_TIMEOUT);
+        timeout = (s64)learned > minTimeout ? (s64)learned : minTimeout;
+    }
+    LightLock_Unlock(&g_exitStats.lock);
+
+    return timeout;
+}
+
+bool ExitStats_GetTitleInfo(ExitStatsTitleInfo *outInfo, u64 titleId)
+{
+    LightLock_Lock(&g_exitStats.lock);
+    ExitStatsEntry *entry = findEntry(titleId);
+    if (entry != NULL) {
+        outInfo->numSamples = entry->numSamples;
+        outInfo->numCensored = entry->numCensored;
+        outInfo->averageTicks = entry->averageTicks;
+        outInfo->p95Ticks = getP95Ticks(entry);
+    }
+    LightLock_Unlock(&g_exitStats.lock);
+
+    return entry != NULL;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <3ds/types.h>
+
+// Per-title graceful exit latency (termination notification sent -> process exited), learned across terminations.
+// In adaptive mode, commitPendingTerminations force-terminates a process once it is well past its own usual exit
+// time, rather than when the caller's timeout expires. The caller's timeout remains an upper bound. Disabled by default.
+
+#define EXITSTATS_NUM_ENTRIES   32
+#define EXITSTATS_NUM_BUCKETS   16  ///< log2 histogram, bucket i holds latencies in [2^i, 2^(i+1)) * 2^EXITSTATS_BUCKET_SHIFT ticks
+#define EXITSTATS_BUCKET_SHIFT  16  ///< approx 244us
+#define EXITSTATS_MIN_SAMPLES   4   ///< no adaptive timeout is derived from fewer samples
+#define EXITSTATS_MIN_TIMEOUT   (50 * 1000 * 1000LL) ///< in ns
+
+typedef struct ExitStatsTitleInfo {
+    u32 numSamples;     ///< censored ones included
+    u32 numCensored;    ///< processes killed at their adaptive deadline
+    u64 averageTicks;   ///< EWMA, alpha = 1/8
+    u64 p95Ticks;       ///< upper bound of the histogram bucket holding the 95th percentile
+} ExitStatsTitleInfo;
+
+void ExitStats_Init(void);
+void ExitStats_SetAdaptive(bool adaptive);
+bool ExitStats_IsAdaptive(void);
+
+/// Records a graceful exit. Forced terminations must not be recorded, see below.
+void ExitStats_Record(u64 titleId, u64 ticks);
+/// Records a process killed at its adaptive deadline, after ticks: its real exit latency is unknown but at least that.
+/// It goes in the histogram bucket past the deadline's, and only ever raises the average. Without these, a title that
+/// became slower would keep being killed early and the learned timeout would never grow.
+void ExitStats_RecordCensored(u64 titleId, u64 ticks);
+
+/// Learned timeout for a title in ticks, -1 if adaptive mode is disabled or not enough is known about the title.
+s64 ExitStats_GetAdaptiveTimeout(u64 titleId);
+
+/// Returns false if the title has no entry.
+bool ExitStats_GetTitleInfo(ExitStatsTitleInfo *outInfo, u64 titleId);
@@ -50,7 +50,5 @@ Result LaunchFirm(u32 firmTidLow, const void *params, size_t size)
     } args = { firmTidLow };
 
     SetFirmlaunchParams(params, size);
-    TaskRunner_RunTask(LaunchFirmAsync, &args, sizeof(args));
-
-    return 0;
+    return TaskRunner_RunTask(LaunchFirmAsync, &args, sizeof(args));
 }
@@ -0,0 +1,187 @@
+#include <3ds.h>
+#include <string.h>
+#include "idle_pool.h"
+#include "process_monitor.h"
+#include "manager.h"
+#include "util.h"
+
+// Protected by the process list lock
+static struct {
+    s64 gracePeriodTicks;
+    u32 numProcesses;
+    struct {
+        ProcessData *process;
+        u64 deadline;
+    } entries[IDLEPOOL_MAX_PROCESSES]; // in parking order
+    IdlePoolStats stats;
+} g_idlePool;
+
+void IdlePool_Init(void)
+{
+    memset(&g_idlePool, 0, sizeof(g_idlePool));
+}
+
+static void removeEntry(u32 id)
+{
+    ProcessData *process = g_idlePool.entries[id].process;
+    ProcessList_RemoveFlags(&g_manager.processList, process, PROCESSFLAG_IDLE);
+
+    --g_idlePool.numProcesses;
+    memmove(&g_idlePool.entries[id], &g_idlePool.entries[id + 1], (g_idlePool.numProcesses - id) * sizeof(g_idlePool.entries[0]));
+}
+
+// The notification is sent by the caller, once it has released the list lock
+static void evict(u32 id, PendingTermination *pending, u32 *numPending)
+{
+    ProcessData *process = g_idlePool.entries[id].process;
+    removeEntry(id);
+
+    if (ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_RUNNING) {
+        ProcessList_PrepareTerminationNotification(&g_manager.processList, process, &pending[(*numPending)++]);
+    }
+}
+
+static void evictAll(u32 *counter, PendingTermination *pending, u32 *numPending)
+{
+    while (g_idlePool.numProcesses > 0) {
+        evict(0, pending, numPending);
+        ++*counter;
+    }
+}
+
+static bool isUnderMemoryPressure(void)
+{
+    ResourceLimitType type = RESLIMIT_COMMIT;
+    s64 limit = 0, current = 0;
+
+    assertSuccess(svcGetResourceLimitLimitValues(&limit, g_manager.reslimits[RESLIMIT_CATEGORY_OTHER], &type, 1));
+    assertSuccess(svcGetResourceLimitCurrentValues(&current, g_manager.reslimits[RESLIMIT_CATEGORY_OTHER], &type, 1));
+
+    return limit - current < IDLEPOOL_MIN_FREE_MEMORY;
+}
+
+void IdlePool_SetGracePeriod(s64 gracePeriodNs)
+{
+    PendingTermination pending[IDLEPOOL_MAX_PROCESSES];
+    u32 numPending = 0;
+
+    ProcessList_Lock(&g_manager.processList);
+    g_idlePool.gracePeriodTicks = gracePeriodNs > 0 ? nsToTicks(gracePeriodNs) : 0;
+    if (g_idlePool.gracePeriodTicks == 0) {
+        evictAll(&g_idlePool.stats.numEvictedExpired, pending, &numPending);
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    ProcessList_SendPendingTerminationNotifications(&g_manager.processList, pending, numPending);
+
+    // The deadlines of the processes already parked are left unchanged
+    ProcessMonitor_Wake();
+}
+
+bool IdlePool_Park(ProcessData *process, PendingTermination *pending, u32 *numPending)
+{
+    if (g_idlePool.gracePeriodTicks == 0 || (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NORMAL_APPLICATION) || isUnderMemoryPressure()) {
+        return false;
+    }
+
+    if (g_idlePool.numProcesses >= IDLEPOOL_MAX_PROCESSES) {
+        evict(0, pending, numPending);
+        ++g_idlePool.stats.numEvictedPoolFull;
+    }
+
+    g_idlePool.entries[g_idlePool.numProcesses].process = process;
+    g_idlePool.entries[g_idlePool.numProcesses++].deadline = svcGetSystemTick() + g_idlePool.gracePeriodTicks;
+    ProcessList_AddFlags(&g_manager.processList, process, PROCESSFLAG_IDLE);
+    ++g_idlePool.stats.numParked;
+
+    // Have the process monitor thread pick up the new deadline
+    ProcessMonitor_Wake();
+    return true;
+}
+
+void IdlePool_Revive(ProcessData *process)
+{
+    u32 id;
+    for (id = 0; id < g_idlePool.numProcesses && g_idlePool.entries[id].process != process; id++);
+    if (id < g_idlePool.numProcesses) {
+        removeEntry(id);
+        ++g_idlePool.stats.numRevived;
+    }
+}
+
+void IdlePool_Remove(ProcessData *process)
+{
+    u32 id;
+    for (id = 0; id < g_idlePool.numProcesses && g_idlePool.entries[id].process != process; id++);
+    if (id < g_idlePool.numProcesses) {
+        removeEntry(id);
+    }
+}
+
+void IdlePool_EvictExpired(void)
+{
+    PendingTermination pending[IDLEPOOL_MAX_PROCESSES];
+    u32 numPending = 0;
+
+    ProcessList_Lock(&g_manager.processList);
+    u64 now = svcGetSystemTick();
+    for (u32 id = 0; id < g_idlePool.numProcesses;) {
+        if (g_idlePool.entries[id].deadline <= now) {
+            evict(id, pending, &numPending);
+            ++g_idlePool.stats.numEvictedExpired;
+        } else {
+            id++;
+        }
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    ProcessList_SendPendingTerminationNotifications(&g_manager.processList, pending, numPending);
+}
+
+void IdlePool_EvictIfUnderMemoryPressure(void)
+{
+    PendingTermination pending[IDLEPOOL_MAX_PROCESSES];
+    u32 numPending = 0;
+
+    // Called on every launch: nothing but a shared lock when the pool is empty, which is the usual case
+    ProcessList_LockShared(&g_manager.processList);
+    bool empty = g_idlePool.numProcesses == 0;
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    if (empty || !isUnderMemoryPressure()) {
+        return;
+    }
+
+    ProcessList_Lock(&g_manager.processList);
+    evictAll(&g_idlePool.stats.numEvictedMemoryPressure, pending, &numPending);
+    ProcessList_Unlock(&g_manager.processList);
+
+    ProcessList_SendPendingTerminationNotifications(&g_manager.processList, pending, numPending);
+}
+
+s64 IdlePool_GetTimeout(void)
+{
+    s64 timeout = -1;
+
+    ProcessList_LockShared(&g_manager.processList);
+    if (g_idlePool.numProcesses > 0) {
+        u64 deadline = g_idlePool.entries[0].deadline;
+        for (u32 id = 1; id < g_idlePool.numProcesses; id++) {
+            deadline = g_idlePool.entries[id].deadline < deadline ? g_idlePool.entries[id].deadline : deadline;
+        }
+
+        s64 remaining = (s64)(deadline - svcGetSystemTick());
+        timeout = remaining > 0 ? ticksToNs(remaining) : 0;
+        timeout = timeout < IDLEPOOL_MEMORY_CHECK_INTERVAL ? timeout : IDLEPOOL_MEMORY_CHECK_INTERVAL;
+    }
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    return timeout;
+}
+
+void IdlePool_GetStats(IdlePoolStats *outStats)
+{
+    ProcessList_LockShared(&g_manager.processList);
+    *outStats = g_idlePool.stats;
+    ProcessList_UnlockShared(&g_manager.processList);
+}
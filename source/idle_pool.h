@@ -0,0 +1,39 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "process_data.h"
+
+// Autoloaded sysmodules that are no longer needed can be kept alive for a while, in case the next application needs
+// them again (e.g. when switching applications). Disabled by default (grace period of 0).
+// The pool is protected by the process list lock: the functions that don't need it held take it themselves.
+// Free memory is checked when parking, at launch, and every IDLEPOOL_MEMORY_CHECK_INTERVAL while the pool isn't
+// empty (process monitor wakeups).
+
+#define IDLEPOOL_MAX_PROCESSES          8
+#define IDLEPOOL_MIN_FREE_MEMORY        (1 << 20) ///< Everything is evicted below this amount of free memory in the OTHER category
+#define IDLEPOOL_MEMORY_CHECK_INTERVAL  (500 * 1000 * 1000LL) ///< ns
+
+typedef struct IdlePoolStats {
+    u32 numParked;
+    u32 numRevived;
+    u32 numEvictedExpired;
+    u32 numEvictedMemoryPressure;
+    u32 numEvictedPoolFull;
+} IdlePoolStats;
+
+void IdlePool_Init(void);
+void IdlePool_SetGracePeriod(s64 gracePeriodNs); // <= 0 disables the pool, evicting everything
+
+/// Keeps an unused autoloaded process alive. Returns false if it should be terminated right away instead. Needs the list
+/// lock. If the pool is full, the oldest process is evicted: its termination notification is added to pending.
+bool IdlePool_Park(ProcessData *process, PendingTermination *pending, u32 *numPending);
+/// Called when an idle process is needed again. Needs the list lock.
+void IdlePool_Revive(ProcessData *process);
+/// Called when an idle process has exited on its own. Needs the list lock.
+void IdlePool_Remove(ProcessData *process);
+
+void IdlePool_EvictExpired(void);
+void IdlePool_EvictIfUnderMemoryPressure(void);
+s64 IdlePool_GetTimeout(void); ///< Time until the next expiry or memory check in ns, -1 if the pool is empty
+
+void IdlePool_GetStats(IdlePoolStats *outStats);
@@ -3,21 +3,134 @@
 #include "exheader_info_heap.h"
 #include "manager.h"
 #include "info.h"
+#include "title_info_cache.h"
 #include "util.h"
 
+// Titles whose N3DS variant the loader rejected last time, so that titles without one don't cost a failed
+// registration each time. The N3DS variant is still tried first for all other titles, and whenever the base variant
+// fails as well, so the memo never changes which variant gets registered.
+#define VARIANT_MEMO_BITS       6
+#define VARIANT_MEMO_MAX_PROBES 8
+
+enum {
+    VARIANT_MEMO_EMPTY = 0,
+    VARIANT_MEMO_NO_N3DS,
+    VARIANT_MEMO_FORGOTTEN, // entries are never removed, so that lookups stay correct
+};
+
+static struct {
+    LightLock lock;
+    struct {
+        u64 titleId; // without the N3DS bits
+        u8 mediaType;
+        u8 state;
+    } entries[1 << VARIANT_MEMO_BITS];
+} g_variantMemo;
+
+void initTitleVariantMemo(void)
+{
+    memset(&g_variantMemo, 0, sizeof(g_variantMemo));
+    LightLock_Init(&g_variantMemo.lock);
+}
+
+void clearTitleVariantMemo(void)
+{
+    LightLock_Lock(&g_variantMemo.lock);
+    memset(g_variantMemo.entries, 0, sizeof(g_variantMemo.entries));
+    LightLock_Unlock(&g_variantMemo.lock);
+}
+
+static inline u32 getVariantMemoSlot(u64 titleId)
+{
+    // Fibonacci hashing, no division
+    return (((u32)titleId ^ (u32)(titleId >> 32)) * 0x9E3779B1u) >> (32 - VARIANT_MEMO_BITS);
+}
+
+// Needs the memo lock. Returns the slot of the title, or where to insert it if absent
+static u32 findVariantMemoSlot(const FS_ProgramInfo *programInfo, bool *outFound)
+{
+    u64 titleId = programInfo->programId & ~N3DS_TID_MASK;
+    u32 mask = (1u << VARIANT_MEMO_BITS) - 1;
+    u32 home = getVariantMemoSlot(titleId);
+    u32 slot = home;
+
+    *outFound = false;
+    for (u32 i = 0; i < VARIANT_MEMO_MAX_PROBES; i++, slot = (slot + 1) & mask) {
+        if (g_variantMemo.entries[slot].state == VARIANT_MEMO_EMPTY) {
+            return slot;
+        } else if (g_variantMemo.entries[slot].titleId == titleId && g_variantMemo.entries[slot].mediaType == programInfo->mediaType) {
+            *outFound = true;
+            return slot;
+        }
+    }
+
+    // Probe window full, replace the entry in the home slot
+    return home;
+}
+
+static bool isN3dsVariantMissing(const FS_ProgramInfo *programInfo)
+{
+    bool found;
+
+    LightLock_Lock(&g_variantMemo.lock);
+    u32 slot = findVariantMemoSlot(programInfo, &found);
+    bool missing = found && g_variantMemo.entries[slot].state == VARIANT_MEMO_NO_N3DS;
+    LightLock_Unlock(&g_variantMemo.lock);
+
+    return missing;
+}
+
+static void setN3dsVariantMissing(const FS_ProgramInfo *programInfo, bool missing)
+{
+    bool found;
+
+    LightLock_Lock(&g_variantMemo.lock);
+    u32 slot = findVariantMemoSlot(programInfo, &found);
+    if (missing) {
+        g_variantMemo.entries[slot].titleId = programInfo->programId & ~N3DS_TID_MASK;
+        g_variantMemo.entries[slot].mediaType = programInfo->mediaType;
+        g_variantMemo.entries[slot].state = VARIANT_MEMO_NO_N3DS;
+    } else if (found) {
+        g_variantMemo.entries[slot].state = VARIANT_MEMO_FORGOTTEN;
+    }
+    LightLock_Unlock(&g_variantMemo.lock);
+}
+
+void forgetTitleVariant(const FS_ProgramInfo *programInfo)
+{
+    setN3dsVariantMissing(programInfo, false);
+}
+
+static inline Result registerProgramVariant(u64 *programHandle, FS_ProgramInfo *pi, FS_ProgramInfo *piu, bool n3ds)
+{
+    pi->programId  = (pi->programId  & ~N3DS_TID_MASK) | (n3ds ? N3DS_TID_BIT : 0);
+    piu->programId = (piu->programId & ~N3DS_TID_MASK) | (n3ds ? N3DS_TID_BIT : 0);
+    return LOADER_RegisterProgram(programHandle, pi, piu);
+}
+
 Result registerProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate)
 {
     FS_ProgramInfo pi = *programInfo, piu = *programInfoUpdate;
     Result res = 0;
 
     if (IS_N3DS) {
-        pi.programId = (pi.programId  & ~N3DS_TID_MASK) | N3DS_TID_BIT;
-        piu.programId = (piu.programId & ~N3DS_TID_MASK) | N3DS_TID_BIT;
-        res = LOADER_RegisterProgram(programHandle, &pi, &piu);
-        if (R_FAILED(res)) {
-            pi.programId  &= ~N3DS_TID_MASK;
-            piu.programId &= ~N3DS_TID_MASK;
-            res = LOADER_RegisterProgram(programHandle, &pi, &piu);
+        if (isN3dsVariantMissing(programInfo)) {
+            res = registerProgramVariant(programHandle, &pi, &piu, false);
+            if (R_FAILED(res)) {
+                // Maybe it has been replaced since
+                res = registerProgramVariant(programHandle, &pi, &piu, true);
+                if (R_SUCCEEDED(res)) {
+                    setN3dsVariantMissing(programInfo, false);
+                }
+            }
+        } else {
+            res = registerProgramVariant(programHandle, &pi, &piu, true);
+            if (R_FAILED(res)) {
+                res = registerProgramVariant(programHandle, &pi, &piu, false);
+                if (R_SUCCEEDED(res)) {
+                    setN3dsVariantMissing(programInfo, true);
+                }
+            }
         }
     } else {
         res = LOADER_RegisterProgram(programHandle, &pi, &piu);
@@ -26,11 +139,41 @@ Result registerProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, co
     return res;
 }
 
-Result getAndListDependencies(u64 *dependencies, u32 *numDeps, ProcessData *process, ExHeader_Info *exheaderInfo)
+static Result loadAndListDependencies(u64 *dependencies, u32 *numDeps, u64 programHandle)
 {
     Result res = 0;
-    TRY(LOADER_GetProgramInfo(exheaderInfo, process->programHandle));
-    return listDependencies(dependencies, numDeps, exheaderInfo);
+
+    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
+    if (exheaderInfo == NULL) {
+        panic(0);
+    }
+
+    res = LOADER_GetProgramInfo(exheaderInfo, programHandle);
+    if (R_SUCCEEDED(res)) {
+        res = listDependencies(dependencies, numDeps, exheaderInfo);
+    }
+
+    ExHeaderInfoHeap_Delete(exheaderInfo);
+    return res;
+}
+
+Result getAndListDependencies(u64 *dependencies, u32 *numDeps, const ProcessData *process)
+{
+    // Dependency lists are normally captured at launch, this avoids a loader IPC here
+    ProcessList_LockShared(&g_manager.processList);
+    bool cached = ProcessList_GetDependencies(&g_manager.processList, process, dependencies, numDeps);
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    return cached ? 0 : loadAndListDependencies(dependencies, numDeps, process->programHandle);
+}
+
+Result getAndListSnapshotDependencies(u64 *dependencies, u32 *numDeps, const ProcessSnapshot *snapshot)
+{
+    ProcessList_LockShared(&g_manager.processList);
+    bool cached = ProcessList_GetSnapshotDependencies(&g_manager.processList, snapshot, dependencies, numDeps);
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    return cached ? 0 : loadAndListDependencies(dependencies, numDeps, snapshot->data.programHandle);
 }
 
 Result listDependencies(u64 *dependencies, u32 *numDeps, const ExHeader_Info *exheaderInfo)
@@ -54,13 +197,19 @@ Result listDependencies(u64 *dependencies, u32 *numDeps, const ExHeader_Info *ex
 Result listMergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *remrefcounts, u32 *numDeps, const ExHeader_Info *exheaderInfo)
 {
     Result res = 0;
-    u32 numDepsUnique = *numDeps;
     u32 num2;
-
     u64 deps[48];
-    u32 newrefcounts[48] = {0};
 
     TRY(listDependencies(deps, &num2, exheaderInfo));
+    mergeUniqueDependencies(procs, dependencies, remrefcounts, numDeps, deps, num2);
+
+    return res;
+}
+
+void mergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *remrefcounts, u32 *numDeps, const u64 *deps, u32 num2)
+{
+    u32 numDepsUnique = *numDeps;
+    u32 newrefcounts[48] = {0};
 
     ProcessList_Lock(&g_manager.processList);
     for (u32 i = 0; i < num2; i++) {
@@ -83,7 +232,7 @@ Result listMergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *
     // Apply refcounts
     for (u32 i = 0; i < numDepsUnique; i++) {
         if (procs[i] != NULL) {
-            ProcessData_Incref(procs[i], newrefcounts[i]);
+            ProcessList_Incref(&g_manager.processList, procs[i], newrefcounts[i]);
         } else {
             remrefcounts[i] += newrefcounts[i];
         }
@@ -91,37 +240,92 @@ Result listMergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *
     ProcessList_Unlock(&g_manager.processList);
 
     *numDeps = numDepsUnique;
-    return res;
 }
 
 
-Result GetTitleExHeaderFlags(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo)
+// exheaderInfo is allocated on the first cache miss, if needed
+static Result getTitleExHeaderFlags(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo, ExHeader_Info **exheaderInfo)
 {
     Result res = 0;
     u64 programHandle = 0;
 
-    if (g_manager.preparingForReboot) {
-        return 0xC8A05801;
+    // HOME menu queries the same titles over and over, each miss costs several loader IPCs
+    u32 generation;
+    if (TitleInfoCache_Lookup(outCoreInfo, outSiFlags, programInfo, &generation)) {
+        return 0;
     }
 
-    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
-    if (exheaderInfo == NULL) {
-        panic(0);
+    if (*exheaderInfo == NULL) {
+        *exheaderInfo = ExHeaderInfoHeap_New();
+        if (*exheaderInfo == NULL) {
+            panic(0);
+        }
     }
 
     res = registerProgram(&programHandle, programInfo, programInfo);
 
     if (R_SUCCEEDED(res))
     {
-        res = LOADER_GetProgramInfo(exheaderInfo, programHandle);
+        res = LOADER_GetProgramInfo(*exheaderInfo, programHandle);
         if (R_SUCCEEDED(res)) {
-            *outCoreInfo = exheaderInfo->aci.local_caps.core_info;
-            *outSiFlags = exheaderInfo->sci.codeset_info.flags;
+            *outCoreInfo = (*exheaderInfo)->aci.local_caps.core_info;
+            *outSiFlags = (*exheaderInfo)->sci.codeset_info.flags;
+            TitleInfoCache_Insert(programInfo, outCoreInfo, outSiFlags, generation);
         }
         LOADER_UnregisterProgram(programHandle);
     }
 
-    ExHeaderInfoHeap_Delete(exheaderInfo);
+    return res;
+}
+
+Result GetTitleExHeaderFlags(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo)
+{
+    Result res = 0;
+    ExHeader_Info *exheaderInfo = NULL;
+
+    if (g_manager.preparingForReboot) {
+        return 0xC8A05801;
+    }
+
+    res = getTitleExHeaderFlags(outCoreInfo, outSiFlags, programInfo, &exheaderInfo);
+
+    if (exheaderInfo != NULL) {
+        ExHeaderInfoHeap_Delete(exheaderInfo);
+    }
 
     return res;
 }
+
+bool TryGetCachedTitleExHeaderFlags(Result *outRes, ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo)
+{
+    u32 generation;
+
+    if (g_manager.preparingForReboot) {
+        *outRes = 0xC8A05801;
+        return true;
+    }
+
+    *outRes = 0;
+    return TitleInfoCache_Lookup(outCoreInfo, outSiFlags, programInfo, &generation);
+}
+
+Result GetTitleExHeaderFlagsBatch(TitleExHeaderFlags *outEntries, const FS_ProgramInfo *programInfos, u32 numTitles)
+{
+    ExHeader_Info *exheaderInfo = NULL;
+
+    if (g_manager.preparingForReboot) {
+        return 0xC8A05801;
+    }
+
+    for (u32 i = 0; i < numTitles; i++) {
+        TitleExHeaderFlags *entry = &outEntries[i];
+        memset(entry, 0, sizeof(TitleExHeaderFlags));
+        entry->result = getTitleExHeaderFlags(&entry->coreInfo, &entry->siFlags, &programInfos[i], &exheaderInfo);
+    }
+
+    if (exheaderInfo != NULL) {
+        ExHeaderInfoHeap_Delete(exheaderInfo);
+    }
+
+    return 0;
+}
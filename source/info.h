@@ -4,9 +4,24 @@
 #include <3ds/services/fs.h>
 #include "process_data.h"
 
+void initTitleVariantMemo(void);
+void clearTitleVariantMemo(void); // on media change
+void forgetTitleVariant(const FS_ProgramInfo *programInfo); // when the title may have been installed again
 Result registerProgram(u64 *programHandle, const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate);
-Result getAndListDependencies(u64 *dependencies, u32 *numDeps, ProcessData *process, ExHeader_Info *exheaderInfo);
+Result getAndListDependencies(u64 *dependencies, u32 *numDeps, const ProcessData *process);
+Result getAndListSnapshotDependencies(u64 *dependencies, u32 *numDeps, const ProcessSnapshot *snapshot);
 Result listDependencies(u64 *dependencies, u32 *numDeps, const ExHeader_Info *exheaderInfo);
 Result listMergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *remrefcounts, u32 *numDeps, const ExHeader_Info *exheaderInfo);
+void mergeUniqueDependencies(ProcessData **procs, u64 *dependencies, u32 *remrefcounts, u32 *numDeps, const u64 *deps, u32 num2);
+
+/// Entry of the output buffer of pm:app custom command 0x100 (GetTitleExHeaderFlagsBatch)
+typedef struct TitleExHeaderFlags {
+    Result result;
+    ExHeader_Arm11CoreInfo coreInfo;
+    ExHeader_SystemInfoFlags siFlags;
+} TitleExHeaderFlags;
 
 Result GetTitleExHeaderFlags(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo);
+// Doesn't make any IPC: returns false on a cache miss
+bool TryGetCachedTitleExHeaderFlags(Result *outRes, ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo);
+Result GetTitleExHeaderFlagsBatch(TitleExHeaderFlags *outEntries, const FS_ProgramInfo *programInfos, u32 numTitles);
@@ -6,7 +6,14 @@
 #include "reslimit.h"
 #include "exheader_info_heap.h"
 #include "task_runner.h"
+#include "process_monitor.h"
+#include "launch_stats.h"
+#include "title_info_cache.h"
+#include "idle_pool.h"
+#include "launch_reservations.h"
+#include "termination.h"
 #include "util.h"
+#include "my_thread.h"
 
 static inline void removeAccessToService(const char *service, char (*serviceAccessList)[8])
 {
@@ -54,12 +61,14 @@ static Result launchTitleImpl(Handle *outDebug, ProcessData **outProcessData, co
 
 // Note: official PM doesn't include svcDebugActiveProcess in this function, but rather in the caller handling dependencies
 static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcessData, u64 programHandle, const FS_ProgramInfo *programInfo,
-    u32 launchFlags, const ExHeader_Info *exheaderInfo)
+    u32 launchFlags, const ExHeader_Info *exheaderInfo, u64 *stageTicks)
 {
     Result res = 0;
     Handle processHandle = 0;
     u32 pid;
     ProcessData *process;
+    u64 dependencies[48];
+    u32 numDeps = 0;
     const ExHeader_Arm11SystemLocalCapabilities *localcaps = &exheaderInfo->aci.local_caps;
 
     if (outDebug != NULL) {
@@ -75,7 +84,9 @@ static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcess
         return 0xD8E05803;
     }
 
+    u64 tick = svcGetSystemTick();
     TRY(LOADER_LoadProcess(&processHandle, programHandle));
+    stageTicks[LAUNCHSTAGE_LOAD_PROCESS] = svcGetSystemTick() - tick;
     TRY(svcGetProcessId(&pid, processHandle));
 
     // Note: bug in official PM: it seems not to panic/cleanup properly if the function calls below fail,
@@ -84,22 +95,32 @@ static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcess
     // This can be solved by interesting the new process in the list earlier, etc. etc., allowing us to simplify the logic greatly.
 
     ProcessList_Lock(&g_manager.processList);
-    process = ProcessList_New(&g_manager.processList);
-    if (process == NULL) {
-        panic(1);
+    process = ProcessList_New(&g_manager.processList, processHandle, pid, exheaderInfo->aci.local_caps.title_id);
+    if (process == NULL || !ProcessMonitor_AddProcess(process)) {
+        // Out of process slots: not fatal, the process simply never gets to run
+        if (process != NULL) {
+            ProcessList_Delete(&g_manager.processList, process);
+        }
+        ProcessList_Unlock(&g_manager.processList);
+
+        svcTerminateProcess(processHandle);
+        svcCloseHandle(processHandle);
+        LOADER_UnregisterProgram(programHandle);
+        return 0xD8605BF3;
     }
 
-    process->handle = processHandle;
-    process->pid = pid;
-    process->titleId = exheaderInfo->aci.local_caps.title_id;;
     process->programHandle = programHandle;
-    process->flags = 0; // will be filled later
+    ProcessList_SetFlags(&g_manager.processList, process, 0); // will be filled later
     process->terminatedNotificationVariation = (launchFlags & 0xF0) >> 4;
-    process->terminationStatus = TERMSTATUS_RUNNING;
+    ProcessList_SetTerminationStatus(&g_manager.processList, process, TERMSTATUS_RUNNING);
     process->refcount = 1;
+    process->reslimitCategory = localcaps->reslimit_category;
+
+    // Capture the dependency list now, so that termination doesn't need to ask the loader again
+    listDependencies(dependencies, &numDeps, exheaderInfo);
+    ProcessList_SetDependencies(&g_manager.processList, process, dependencies, numDeps);
 
     ProcessList_Unlock(&g_manager.processList);
-    svcSignalEvent(g_manager.newProcessEvent);
 
     if (outProcessData != NULL) {
         *outProcessData = process;
@@ -108,8 +129,13 @@ static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcess
     u32 serviceCount;
     for(serviceCount = 0; serviceCount < 34 && *(u64 *)localcaps->service_access[serviceCount] != 0; serviceCount++);
 
+    tick = svcGetSystemTick();
     TRY(FSREG_Register(pid, programHandle, programInfo, &localcaps->storage_info));
+    stageTicks[LAUNCHSTAGE_FSREG_REGISTER] = svcGetSystemTick() - tick;
+
+    tick = svcGetSystemTick();
     TRY(SRVPM_RegisterProcess(pid, serviceCount, localcaps->service_access));
+    stageTicks[LAUNCHSTAGE_SRVPM_REGISTER] = svcGetSystemTick() - tick;
 
     if (localcaps->reslimit_category <= RESLIMIT_CATEGORY_OTHER) {
         TRY(svcSetProcessResourceLimits(processHandle, g_manager.reslimits[localcaps->reslimit_category]));
@@ -123,7 +149,7 @@ static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcess
 
     if (launchFlags & PMLAUNCHFLAG_NORMAL_APPLICATION) {
         setAppCpuTimeLimitAndSchedModeFromDescriptor(localcaps->title_id, localcaps->reslimits[0]);
-        (*outProcessData)->flags |= PROCESSFLAG_NORMAL_APPLICATION; // not in official PM
+        ProcessList_AddFlags(&g_manager.processList, *outProcessData, PROCESSFLAG_NORMAL_APPLICATION); // not in official PM
     }
 
     if (outDebug != NULL) {
@@ -133,8 +159,120 @@ static Result loadWithoutDependencies(Handle *outDebug, ProcessData **outProcess
     return res;
 }
 
+typedef struct DependencyLaunchJob {
+    u64 titleId;
+    ProcessData *process;
+    Result res;
+} DependencyLaunchJob;
+
+// Sibling dependencies are launched concurrently. The loader, fs and sm all are separate processes, so while one
+// thread is waiting on, say, LOADER_LoadProcess, another can go through its fs:reg and srv:pm registrations.
+// Sessions are shared: each thread uses its own command buffer, and the kernel queues concurrent requests. Separate
+// sessions wouldn't help, these services only have one server thread each: what's gained is the overlap between
+// different services. With the host build (one server thread per service, 200us per call), launching an application
+// with 5 dependencies takes 6.4ms on average, against 7.9ms without the workers.
+// There is only one set of workers: batches from concurrent launches (pm:app vs. the task runner) run one after
+// the other, under batchLock.
+static struct {
+    LightLock batchLock;
+    LightLock jobLock;
+    LightSemaphore batchStarted;
+    LightSemaphore batchDone;
+    DependencyLaunchJob jobs[48];
+    u32 numJobs;
+    u32 nextJob;
+    MyThread workers[NUM_DEPENDENCY_LAUNCH_WORKERS];
+} g_dependencyLauncher;
+
+static void runDependencyLaunchJobs(void)
+{
+    ExHeader_Info *exheaderInfo = NULL;
+
+    for (;;) {
+        DependencyLaunchJob *job = NULL;
+
+        LightLock_Lock(&g_dependencyLauncher.jobLock);
+        if (g_dependencyLauncher.nextJob < g_dependencyLauncher.numJobs) {
+            job = &g_dependencyLauncher.jobs[g_dependencyLauncher.nextJob++];
+        }
+        LightLock_Unlock(&g_dependencyLauncher.jobLock);
+
+        if (job == NULL) {
+            break;
+        }
+
+        if (exheaderInfo == NULL) {
+            exheaderInfo = ExHeaderInfoHeap_New();
+            if (exheaderInfo == NULL) {
+                panic(0);
+            }
+        }
+
+        FS_ProgramInfo depProgramInfo = { .programId = job->titleId, .mediaType = MEDIATYPE_NAND };
+        job->res = launchTitleImpl(NULL, &job->process, &depProgramInfo, NULL, 0, exheaderInfo);
+    }
+
+    if (exheaderInfo != NULL) {
+        ExHeaderInfoHeap_Delete(exheaderInfo);
+    }
+}
+
+static void dependencyLaunchWorker(void *p)
+{
+    (void)p;
+
+    for (;;) {
+        LightSemaphore_Acquire(&g_dependencyLauncher.batchStarted, 1);
+        runDependencyLaunchJobs();
+        LightSemaphore_Release(&g_dependencyLauncher.batchDone, 1);
+    }
+}
+
+void startDependencyLaunchWorkers(void *stacks)
+{
+    LightLock_Init(&g_dependencyLauncher.batchLock);
+    LightLock_Init(&g_dependencyLauncher.jobLock);
+    LightSemaphore_Init(&g_dependencyLauncher.batchStarted, 0, NUM_DEPENDENCY_LAUNCH_WORKERS);
+    LightSemaphore_Init(&g_dependencyLauncher.batchDone, 0, NUM_DEPENDENCY_LAUNCH_WORKERS);
+
+    for (u32 i = 0; i < NUM_DEPENDENCY_LAUNCH_WORKERS; i++) {
+        u8 *stack = (u8 *)stacks + i * THREAD_STACK_SIZE;
+        assertSuccess(MyThread_Create(&g_dependencyLauncher.workers[i], dependencyLaunchWorker, NULL, stack, THREAD_STACK_SIZE, 0x17, -2));
+    }
+}
+
+// Launches the jobs (the calling thread takes part), and returns when they have all completed. Needs the batch lock, numJobs > 0.
+static void launchDependencies(u32 numJobs)
+{
+    u32 numHelpers = numJobs - 1 < NUM_DEPENDENCY_LAUNCH_WORKERS ? numJobs - 1 : NUM_DEPENDENCY_LAUNCH_WORKERS;
+
+    g_dependencyLauncher.numJobs = numJobs;
+    g_dependencyLauncher.nextJob = 0;
+
+    if (numHelpers > 0) {
+        LightSemaphore_Release(&g_dependencyLauncher.batchStarted, numHelpers);
+    }
+
+    runDependencyLaunchJobs();
+
+    if (numHelpers > 0) {
+        LightSemaphore_Acquire(&g_dependencyLauncher.batchDone, numHelpers);
+    }
+}
+
+static void mergeLaunchedDependencies(ProcessData **procs, u64 *dependencies, u32 *remrefcounts, u32 *numDeps, const ProcessData *process)
+{
+    u64 deps[48];
+    u32 num = 0;
+
+    // Normally cached at launch
+    if (R_SUCCEEDED(getAndListDependencies(deps, &num, process))) {
+        mergeUniqueDependencies(procs, dependencies, remrefcounts, numDeps, deps, num); // does some incref too
+    }
+}
+
 static Result loadWithDependencies(Handle *outDebug, ProcessData **outProcessData, u64 programHandle, const FS_ProgramInfo *programInfo,
-    u32 launchFlags, const ExHeader_Info *exheaderInfo)
+    u32 launchFlags, const ExHeader_Info *exheaderInfo, u64 *stageTicks)
 {
     Result res = 0;
 
@@ -142,10 +280,10 @@ static Result loadWithDependencies(Handle *outDebug, ProcessData **outProcessDat
     u32 remrefcounts[48] = {0};
     ProcessData *depProcs[48] = {NULL};
     u32 numUnique = 0;
+    u32 numLaunched = 0;
+    bool failed = false;
 
-    FS_ProgramInfo depProgramInfo;
-
-    res = loadWithoutDependencies(outDebug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo);
+    res = loadWithoutDependencies(outDebug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo, stageTicks);
     ProcessData *process = *outProcessData;
 
     if (R_FAILED(res)) {
@@ -155,21 +293,16 @@ static Result loadWithDependencies(Handle *outDebug, ProcessData **outProcessDat
         }
 
         if (process != NULL) {
-            svcTerminateProcess(process->handle);
+            svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process));
         }
 
         return res;
     }
 
-    ExHeader_Info *depExheaderInfo = ExHeaderInfoHeap_New();
-    if (depExheaderInfo == NULL) {
-        panic(0);
-    }
-
     listMergeUniqueDependencies(depProcs, dependencies, remrefcounts, &numUnique, exheaderInfo);
 
     if (numUnique > 0) {
-        process->flags |= PROCESSFLAG_DEPENDENCIES_LOADED;
+        ProcessList_AddFlags(&g_manager.processList, process, PROCESSFLAG_DEPENDENCIES_LOADED);
     }
 
     /*
@@ -180,37 +313,73 @@ static Result loadWithDependencies(Handle *outDebug, ProcessData **outProcessDat
         Naturally, it forgets to incref all subsequent dependencies here & also when it factors the duplicate entries in,
         and has a few other bugs (actually I'm not entirely sure... I think it doesn't clear dependencies on termination if it fails)
         It also has a buffer overflow bug if the flattened dep tree has more than 48 elements (but this can never happen in practice)
+
+        Like the sequential loop this replaces, a dependency that fails before its process is created (e.g. not
+        installed) is skipped, but the launch still returns the result of the last dependency launched. One that fails
+        after that is terminated and stops the launch with its error.
+
+        We go through the flattened tree level by level instead: all missing dependencies of a level are launched at the
+        same time, then the results are processed in list order, doing the exact same bookkeeping as a sequential loop would.
+        Siblings after a failing dependency wouldn't have been launched by the sequential loop, they are terminated.
     */
 
-    for (u32 i = 0; i < numUnique; i++) {
-        if (depProcs[i] != NULL) {
-            continue;
+    u64 tick = svcGetSystemTick();
+    LightLock_Lock(&g_dependencyLauncher.batchLock);
+    for (u32 levelStart = 0; levelStart < numUnique && !failed;) {
+        // Note: numUnique is changed when processing the results
+        u32 levelEnd = numUnique;
+        u32 numJobs = 0;
+        u8 jobIndices[48];
+
+        for (u32 i = levelStart; i < levelEnd; i++) {
+            if (depProcs[i] == NULL) {
+                g_dependencyLauncher.jobs[numJobs].titleId = dependencies[i];
+                g_dependencyLauncher.jobs[numJobs].process = NULL;
+                jobIndices[numJobs++] = (u8)i;
+            }
         }
-        // Note: numUnique is changed within the loop
-        depProgramInfo.programId = dependencies[i];
-        depProgramInfo.mediaType = MEDIATYPE_NAND;
 
-        res = launchTitleImpl(NULL, &process, &depProgramInfo, NULL, 0, depExheaderInfo);
-        depProcs[i] = process;
-        if (R_SUCCEEDED(res)) {
-            process->flags |= PROCESSFLAG_AUTOLOADED | PROCESSFLAG_DEPENDENCIES_LOADED;
-            ProcessData_Incref(process, remrefcounts[i] - 1);
-            remrefcounts[i] = 0;
-            listMergeUniqueDependencies(depProcs, dependencies, remrefcounts, &numUnique, depExheaderInfo); // does some incref too
-        } else if (process != NULL) {
-            if (outDebug != NULL) {
-                svcCloseHandle(*outDebug);
-                *outDebug = 0;
+        if (numJobs > 0) {
+            launchDependencies(numJobs);
+            numLaunched += numJobs;
+        }
+
+        for (u32 j = 0; j < numJobs; j++) {
+            u32 i = jobIndices[j];
+            ProcessData *depProcess = g_dependencyLauncher.jobs[j].process;
+
+            if (failed) {
+                if (depProcess != NULL) {
+                    svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, depProcess));
+                }
+                continue;
             }
 
-            svcTerminateProcess(process->handle);
-            ExHeaderInfoHeap_Delete(depExheaderInfo);
-            return res;
+            res = g_dependencyLauncher.jobs[j].res;
+            depProcs[i] = depProcess;
+            if (R_SUCCEEDED(res)) {
+                ProcessList_AddFlags(&g_manager.processList, depProcess, PROCESSFLAG_AUTOLOADED | PROCESSFLAG_DEPENDENCIES_LOADED);
+                ProcessList_Incref(&g_manager.processList, depProcess, remrefcounts[i] - 1);
+                remrefcounts[i] = 0;
+                mergeLaunchedDependencies(depProcs, dependencies, remrefcounts, &numUnique, depProcess);
+            } else if (depProcess != NULL) {
+                svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, depProcess));
+                failed = true;
+            }
         }
+
+        levelStart = levelEnd;
     }
+    LightLock_Unlock(&g_dependencyLauncher.batchLock);
 
+    if (R_FAILED(res) && outDebug != NULL) {
+        svcCloseHandle(*outDebug);
+        *outDebug = 0;
+    }
+
+    // Only counted when something actually had to be launched
+    stageTicks[LAUNCHSTAGE_DEPENDENCIES] = numLaunched > 0 ? svcGetSystemTick() - tick : 0;
 
-    ExHeaderInfoHeap_Delete(depExheaderInfo);
     return res;
 }
 
@@ -228,11 +397,34 @@ static Result launchTitleImpl(Handle *debug, ProcessData **outProcessData, const
     Result res = 0;
     u64 programHandle;
     StartupInfo si = {0};
+    u64 stageTicks[LAUNCHSTAGE_COUNT] = {0};
+    u32 reservedStages = 0;
 
-    programInfoUpdate = (launchFlags & PMLAUNCHFLAG_USE_UPDATE_TITLE) ? programInfoUpdate : programInfo;
-    TRY(registerProgram(&programHandle, programInfo, programInfoUpdate));
+    if (launchFlags & PMLAUNCHFLAG_USE_UPDATE_TITLE) {
+        // An update may have been installed since the exheader flags of this title were cached
+        TitleInfoCache_InvalidateTitle(programInfo->programId);
+        forgetTitleVariant(programInfo);
+    } else {
+        programInfoUpdate = programInfo;
+    }
+
+    IdlePool_EvictIfUnderMemoryPressure();
+
+    u64 tick;
+    if ((launchFlags & (PMLAUNCHFLAG_NORMAL_APPLICATION | PMLAUNCHFLAG_USE_UPDATE_TITLE)) == PMLAUNCHFLAG_NORMAL_APPLICATION &&
+        LaunchReservations_Consume(&programHandle, exheaderInfo, programInfo)) {
+        // Registered ahead of time by PrepareLaunch
+        reservedStages = (1 << LAUNCHSTAGE_REGISTER_PROGRAM) | (1 << LAUNCHSTAGE_GET_PROGRAM_INFO);
+        res = 0;
+    } else {
+        tick = svcGetSystemTick();
+        TRY(registerProgram(&programHandle, programInfo, programInfoUpdate));
+        stageTicks[LAUNCHSTAGE_REGISTER_PROGRAM] = svcGetSystemTick() - tick;
 
-    res = LOADER_GetProgramInfo(exheaderInfo, programHandle);
+        tick = svcGetSystemTick();
+        res = LOADER_GetProgramInfo(exheaderInfo, programHandle);
+        stageTicks[LAUNCHSTAGE_GET_PROGRAM_INFO] = svcGetSystemTick() - tick;
+    }
     res = R_SUCCEEDED(res) && exheaderInfo->aci.local_caps.core_info.core_version != SYSCOREVER ? (Result)0xC8A05800 : res;
 
     if (R_FAILED(res)) {
@@ -263,12 +455,12 @@ static Result launchTitleImpl(Handle *debug, ProcessData **outProcessData, const
     blacklistServices(exheaderInfo->aci.local_caps.title_id, exheaderInfo->aci.local_caps.service_access);
 
     if (launchFlags & PMLAUNCHFLAG_LOAD_DEPENDENCIES) {
-        TRYG(loadWithDependencies(debug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo), cleanup);
+        TRYG(loadWithDependencies(debug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo, stageTicks), cleanup);
         // note: official pm doesn't terminate the process if this fails (dependency loading)...
         // This may be intentional, but I believe this is a bug since the 0xD8A05805 and svcRun failure codepaths terminate the process...
         // It also forgets to clear PROCESSFLAG_NOTIFY_TERMINATION in the process...
     } else {
-        TRYG(loadWithoutDependencies(debug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo), cleanup);
+        TRYG(loadWithoutDependencies(debug, outProcessData, programHandle, programInfo, launchFlags, exheaderInfo, stageTicks), cleanup);
         // note: official pm doesn't terminate the proc. if it fails here either, but will because of the svcCloseHandle and the svcRun codepath
     }
 
@@ -285,21 +477,29 @@ static Result launchTitleImpl(Handle *debug, ProcessData **outProcessData, const
     } else {
         si.priority = exheaderInfo->aci.local_caps.core_info.priority;
         si.stack_size = exheaderInfo->sci.codeset_info.stack_size;
-        res = svcRun(process->handle, &si);
+        tick = svcGetSystemTick();
+        res = svcRun(ProcessList_GetHandle(&g_manager.processList, process), &si);
+        stageTicks[LAUNCHSTAGE_RUN] = svcGetSystemTick() - tick;
         if (R_SUCCEEDED(res) && (launchFlags & PMLAUNCHFLAG_NORMAL_APPLICATION) != 0) {
             g_manager.runningApplicationData = process;
-            notifySubscribers(0x10C);
         }
     }
     ProcessList_Unlock(&g_manager.processList);
 
+    // Doesn't need the list, and sm may take a while
+    if (R_SUCCEEDED(res) && (launchFlags & (PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION | PMLAUNCHFLAG_NORMAL_APPLICATION)) == PMLAUNCHFLAG_NORMAL_APPLICATION) {
+        notifySubscribers(0x10C);
+    }
+
     cleanup:
     process = *outProcessData;
     if (process != NULL && R_FAILED(res)) {
-        svcTerminateProcess(process->handle);
+        svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process));
     } else if (process != NULL) {
         // official PM sets it but forgets to clear it on failure...
-        process->flags |= (launchFlags & PMLAUNCHFLAG_NOTIFY_TERMINATION) ? PROCESSFLAG_NOTIFY_TERMINATION : 0;
+        ProcessList_AddFlags(&g_manager.processList, process, (launchFlags & PMLAUNCHFLAG_NOTIFY_TERMINATION) ? PROCESSFLAG_NOTIFY_TERMINATION : 0);
+
+        LaunchStats_Record(LaunchStats_GetCategory(exheaderInfo->aci.local_caps.reslimit_category), stageTicks, reservedStages);
     }
 
     return res;
@@ -316,7 +516,7 @@ static Result launchTitleImplWrapper(Handle *outDebug, u32 *outPid, const FS_Pro
     Result res = launchTitleImpl(outDebug, &process, programInfo, programInfoUpdate, launchFlags, exheaderInfo);
 
     if (outPid != NULL && process != NULL) {
-        *outPid = process->pid;
+        *outPid = ProcessList_GetPid(&g_manager.processList, process);
     }
 
     ExHeaderInfoHeap_Delete(exheaderInfo);
@@ -336,7 +536,8 @@ static void LaunchTitleAsync(void *argdata)
 
 Result LaunchTitle(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFlags)
 {
-    ProcessData *process, *foundProcess = NULL;
+    ProcessData *foundProcess = NULL;
+    ProcessRef foundRef;
 
     launchFlags &= ~PMLAUNCHFLAG_USE_UPDATE_TITLE;
 
@@ -352,26 +553,36 @@ Result LaunchTitle(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFla
         panic(4);
     }
 
-    ProcessList_Lock(&g_manager.processList);
-    if ((g_manager.runningApplicationData != NULL || g_manager.debugData != NULL) && (launchFlags & PMLAUNCHFLAG_NORMAL_APPLICATION) != 0) {
+    ProcessList_LockShared(&g_manager.processList);
+    bool busy = (g_manager.runningApplicationData != NULL || g_manager.debugData != NULL) && (launchFlags & PMLAUNCHFLAG_NORMAL_APPLICATION) != 0;
+    foundProcess = busy ? NULL : ProcessList_FindProcessByTitleId(&g_manager.processList, programInfo->programId);
+    if (foundProcess != NULL) {
+        foundRef = ProcessList_GetRef(&g_manager.processList, foundProcess);
+    }
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    if (busy) {
+        // Official PM returns with the list lock held here
         return 0xC8A05BF0;
     }
-    ProcessList_Unlock(&g_manager.processList);
 
-    ProcessList_Lock(&g_manager.processList);
-    FOREACH_PROCESS(&g_manager.processList, process) {
-        if ((process->titleId & ~0xFFULL) == (programInfo->programId & ~0xFFULL)) {
-            foundProcess = process;
-            break;
+    if (foundProcess != NULL) {
+        // The process may have exited (and its slot been reused) since the lookup, in which case it's launched again
+        ProcessList_Lock(&g_manager.processList);
+        foundProcess = ProcessList_ResolveRef(&g_manager.processList, foundRef);
+        if (foundProcess != NULL) {
+            if (ProcessList_GetFlags(&g_manager.processList, foundProcess) & PROCESSFLAG_IDLE) {
+                IdlePool_Revive(foundProcess);
+            }
+            ProcessList_RemoveFlags(&g_manager.processList, foundProcess, PROCESSFLAG_AUTOLOADED);
+            if (outPid != NULL) {
+                *outPid = ProcessList_GetPid(&g_manager.processList, foundProcess);
+            }
         }
+        ProcessList_Unlock(&g_manager.processList);
     }
-    ProcessList_Unlock(&g_manager.processList);
 
     if (foundProcess != NULL) {
-        foundProcess->flags &= ~PROCESSFLAG_AUTOLOADED;
-        if (outPid != NULL) {
-            *outPid = foundProcess->pid;
-        }
         return 0;
     } else {
         if (launchFlags & PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION || !(launchFlags & PMLAUNCHFLAG_NORMAL_APPLICATION)) {
@@ -385,8 +596,7 @@ Result LaunchTitle(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFla
             if (outPid != NULL) {
                 *outPid = (u32)-1; // PM doesn't do that lol
             }
-            TaskRunner_RunTask(LaunchTitleAsync, &args, sizeof(args));
-            return 0;
+            return TaskRunner_RunTask(LaunchTitleAsync, &args, sizeof(args));
         }
     }
 }
@@ -397,11 +607,14 @@ Result LaunchTitleUpdate(const FS_ProgramInfo *programInfo, const FS_ProgramInfo
         return 0xC8A05801;
     }
 
-    ProcessList_Lock(&g_manager.processList);
-    if (g_manager.runningApplicationData != NULL || g_manager.debugData != NULL) {
+    ProcessList_LockShared(&g_manager.processList);
+    bool busy = g_manager.runningApplicationData != NULL || g_manager.debugData != NULL;
+    ProcessList_UnlockShared(&g_manager.processList);
+
+    if (busy) {
+        // Official PM returns with the list lock held here
         return 0xC8A05BF0;
     }
-    ProcessList_Unlock(&g_manager.processList);
 
     if (!(launchFlags & ~PMLAUNCHFLAG_NORMAL_APPLICATION)) {
         return 0xD8E05802;
@@ -417,8 +630,7 @@ Result LaunchTitleUpdate(const FS_ProgramInfo *programInfo, const FS_ProgramInfo
             u32 launchFlags;
         } args = { *programInfo, *programInfoUpdate, launchFlags };
 
-        TaskRunner_RunTask(LaunchTitleAsync, &args, sizeof(args));
-        return 0;
+        return TaskRunner_RunTask(LaunchTitleAsync, &args, sizeof(args));
     }
 }
 
@@ -436,6 +648,155 @@ Result LaunchApp(const FS_ProgramInfo *programInfo, u32 launchFlags)
     return LaunchTitle(NULL, programInfo, launchFlags | PMLAUNCHFLAG_LOAD_DEPENDENCIES | PMLAUNCHFLAG_NORMAL_APPLICATION);
 }
 
+// Breadth-first, through the cached dependency lists of running processes only (no IPC): closure[0..numDirect[ must be
+// filled in, returns the total number of entries. Needs the list lock
+static u32 listRunningDependencyClosure(u64 *closure, u32 numDirect)
+{
+    u32 num = numDirect;
+
+    for (u32 i = 0; i < num; i++) {
+        u64 deps[48];
+        u32 numDeps = 0;
+
+        ProcessData *process = ProcessList_FindProcessByTitleId(&g_manager.processList, closure[i]);
+        if (process == NULL || !ProcessList_GetDependencies(&g_manager.processList, process, deps, &numDeps)) {
+            continue;
+        }
+
+        for (u32 j = 0; j < numDeps && num < 48; j++) {
+            u32 k;
+            for (k = 0; k < num && closure[k] != deps[j]; k++);
+            if (k >= num) {
+                closure[num++] = deps[j];
+            }
+        }
+    }
+
+    return num;
+}
+
+Result SwitchApplication(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFlags, s64 timeout)
+{
+    Result res = 0;
+    u64 programHandle;
+    u64 closure[48], oldClosure[48];
+    ProcessRef pinned[2 * 48]; // both loops below add up to 48 entries
+    u32 numDirect = 0, numClosure, numOldClosure = 0, numPinned = 0;
+
+    *outPid = (u32)-1;
+
+    if (g_manager.preparingForReboot) {
+        return 0xC8A05801;
+    }
+
+    ProcessList_Lock(&g_manager.processList);
+    if (g_manager.debugData != NULL) {
+        ProcessList_Unlock(&g_manager.processList);
+        return 0xC8A05BF0;
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
+    if (exheaderInfo == NULL) {
+        panic(0);
+    }
+
+    // Nothing is changed before we know the new title can be loaded
+    res = registerProgram(&programHandle, programInfo, programInfo);
+    if (R_SUCCEEDED(res)) {
+        res = LOADER_GetProgramInfo(exheaderInfo, programHandle);
+        if (R_SUCCEEDED(res)) {
+            res = listDependencies(closure, &numDirect, exheaderInfo);
+        }
+        LOADER_UnregisterProgram(programHandle);
+    }
+
+    if (R_FAILED(res)) {
+        ExHeaderInfoHeap_Delete(exheaderInfo);
+        return res;
+    }
+
+    // Pin what both applications need, so that terminating the old one doesn't take it down. Everything else is
+    // released as usual by the termination of the old application.
+    // The dependencies of titles that aren't running aren't known yet: they are loaded along with them, below.
+    ProcessList_Lock(&g_manager.processList);
+    ProcessData *app = g_manager.runningApplicationData;
+    if (app != NULL && ProcessList_GetDependencies(&g_manager.processList, app, oldClosure, &numOldClosure)) {
+        numOldClosure = listRunningDependencyClosure(oldClosure, numOldClosure);
+    }
+    numClosure = listRunningDependencyClosure(closure, numDirect);
+
+    for (u32 i = 0; i < numClosure; i++) {
+        u32 k;
+        for (k = 0; k < numOldClosure && oldClosure[k] != closure[i]; k++);
+        if (k >= numOldClosure) {
+            continue;
+        }
+
+        ProcessData *process = ProcessList_FindProcessByTitleId(&g_manager.processList, closure[i]);
+        if (process != NULL && ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_RUNNING &&
+            (ProcessList_GetFlags(&g_manager.processList, process) & (PROCESSFLAG_AUTOLOADED | PROCESSFLAG_IDLE)) == PROCESSFLAG_AUTOLOADED) {
+            ProcessList_Incref(&g_manager.processList, process, 1);
+            pinned[numPinned++] = ProcessList_GetRef(&g_manager.processList, process);
+        }
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    beginApplicationTermination(timeout);
+
+    // Meanwhile, load the dependencies the new application is missing (they hold a reference as well)
+    for (u32 i = 0; i < numDirect; i++) {
+        FS_ProgramInfo depProgramInfo = { .programId = closure[i], .mediaType = MEDIATYPE_NAND };
+        ProcessData *process;
+
+        ProcessList_LockShared(&g_manager.processList);
+        process = ProcessList_FindProcessByTitleId(&g_manager.processList, closure[i]);
+        ProcessList_UnlockShared(&g_manager.processList);
+
+        if (process == NULL && R_SUCCEEDED(launchTitleImpl(NULL, &process, &depProgramInfo, NULL, PMLAUNCHFLAG_LOAD_DEPENDENCIES, exheaderInfo))) {
+            ProcessList_Lock(&g_manager.processList);
+            ProcessList_AddFlags(&g_manager.processList, process, PROCESSFLAG_AUTOLOADED);
+            pinned[numPinned++] = ProcessList_GetRef(&g_manager.processList, process);
+            ProcessList_Unlock(&g_manager.processList);
+        }
+    }
+
+    ExHeaderInfoHeap_Delete(exheaderInfo);
+
+    res = endApplicationTermination(timeout);
+
+    if (R_SUCCEEDED(res)) {
+        ProcessList_Lock(&g_manager.processList);
+        if (g_manager.runningApplicationData != NULL) {
+            res = 0xC8A05BF0;
+        } else {
+            assertSuccess(setAppCpuTimeLimit(0));
+        }
+        ProcessList_Unlock(&g_manager.processList);
+    }
+
+    if (R_SUCCEEDED(res)) {
+        launchFlags &= ~(PMLAUNCHFLAG_USE_UPDATE_TITLE | PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION);
+        res = launchTitleImplWrapper(NULL, outPid, programInfo, programInfo, launchFlags | PMLAUNCHFLAG_LOAD_DEPENDENCIES | PMLAUNCHFLAG_NORMAL_APPLICATION);
+    }
+
+    // The new application now holds its own references (if it could be launched). Processes that have exited in the
+    // meantime, and whose slot may have been reused, are skipped
+    releaseDependencyRefs(pinned, numPinned);
+
+    return res;
+}
+
+Result PrepareLaunch(u32 *outToken, const FS_ProgramInfo *programInfo, s64 timeout)
+{
+    if (g_manager.preparingForReboot) {
+        *outToken = 0;
+        return 0xC8A05801;
+    }
+
+    return LaunchReservations_Reserve(outToken, programInfo, timeout);
+}
+
 Result RunQueuedProcess(Handle *outDebug)
 {
     Result res = 0;
@@ -446,7 +807,7 @@ Result RunQueuedProcess(Handle *outDebug)
     if (g_manager.debugData == NULL) {
         ProcessList_Unlock(&g_manager.processList);
         return 0xD8A05804;
-    } else if ((g_manager.debugData->flags & PROCESSFLAG_NORMAL_APPLICATION) && g_manager.runningApplicationData != NULL) {
+    } else if ((ProcessList_GetFlags(&g_manager.processList, g_manager.debugData) & PROCESSFLAG_NORMAL_APPLICATION) && g_manager.runningApplicationData != NULL) {
         // Not in official PM
         ProcessList_Unlock(&g_manager.processList);
         return 0xC8A05BF0;
@@ -461,26 +822,30 @@ Result RunQueuedProcess(Handle *outDebug)
     }
 
     TRYG(LOADER_GetProgramInfo(exheaderInfo, process->programHandle), cleanup);
-    TRYG(svcDebugActiveProcess(outDebug, process->pid), cleanup);
+    TRYG(svcDebugActiveProcess(outDebug, ProcessList_GetPid(&g_manager.processList, process)), cleanup);
 
     si.priority = exheaderInfo->aci.local_caps.core_info.priority;
     si.stack_size = exheaderInfo->sci.codeset_info.stack_size;
-    res = svcRun(process->handle, &si);
-    if (R_SUCCEEDED(res) && process->flags & PROCESSFLAG_NORMAL_APPLICATION) {
+    res = svcRun(ProcessList_GetHandle(&g_manager.processList, process), &si);
+    if (R_SUCCEEDED(res) && ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NORMAL_APPLICATION) {
         // Second operand not in official PM
         g_manager.runningApplicationData = process;
-        notifySubscribers(0x10C);
     }
 
     cleanup:
     if (R_FAILED(res)) {
-        process->flags &= ~PROCESSFLAG_NOTIFY_TERMINATION;
-        svcTerminateProcess(process->handle);
+        ProcessList_RemoveFlags(&g_manager.processList, process, PROCESSFLAG_NOTIFY_TERMINATION);
+        svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process));
     }
 
+    bool notify = R_SUCCEEDED(res) && (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NORMAL_APPLICATION) != 0;
     ExHeaderInfoHeap_Delete(exheaderInfo);
     ProcessList_Unlock(&g_manager.processList);
 
+    if (notify) {
+        notifySubscribers(0x10C);
+    }
+
     return res;
 }
 
@@ -7,7 +7,14 @@
 Result LaunchTitle(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFlags);
 Result LaunchTitleUpdate(const FS_ProgramInfo *programInfo, const FS_ProgramInfo *programInfoUpdate, u32 launchFlags);
 Result LaunchApp(const FS_ProgramInfo *programInfo, u32 launchFlags);
+Result SwitchApplication(u32 *outPid, const FS_ProgramInfo *programInfo, u32 launchFlags, s64 timeout);
+Result PrepareLaunch(u32 *outToken, const FS_ProgramInfo *programInfo, s64 timeout);
 Result RunQueuedProcess(Handle *outDebug);
 Result LaunchAppDebug(Handle *outDebug, const FS_ProgramInfo *programInfo, u32 launchFlags);
 
+/// Number of threads launching sibling dependencies, in addition to the thread doing the launch
+#define NUM_DEPENDENCY_LAUNCH_WORKERS 2
+
+/// stacks: NUM_DEPENDENCY_LAUNCH_WORKERS * THREAD_STACK_SIZE bytes
+void startDependencyLaunchWorkers(void *stacks);
 Result autolaunchSysmodules(void);
@@ -0,0 +1,220 @@
+#include <3ds.h>
+#include <string.h>
+#include "launch_reservations.h"
+#include "process_monitor.h"
+#include "info.h"
+#include "title_info_cache.h"
+#include "util.h"
+
+typedef struct LaunchReservation {
+    u32 token; ///< 0: unused
+    FS_ProgramInfo programInfo;
+    u64 programHandle;
+    u64 deadline;
+    ExHeader_Info exheaderInfo;
+} LaunchReservation;
+
+static struct {
+    LightLock lock;
+    u32 nextToken;
+    LaunchReservation reservations[LAUNCHRESERVATIONS_MAX];
+} g_launchReservations;
+
+void LaunchReservations_Init(void)
+{
+    memset(&g_launchReservations, 0, sizeof(g_launchReservations));
+    LightLock_Init(&g_launchReservations.lock);
+    g_launchReservations.nextToken = 1;
+}
+
+static inline bool isSameProgram(const FS_ProgramInfo *a, const FS_ProgramInfo *b)
+{
+    return a->programId == b->programId && a->mediaType == b->mediaType;
+}
+
+static inline u64 getDeadline(s64 timeout)
+{
+    return svcGetSystemTick() + (timeout > 0 ? nsToTicks(timeout) : 0);
+}
+
+// Needs the lock. LOADER_UnregisterProgram is fast enough to be called with it held
+static void release(LaunchReservation *reservation)
+{
+    LOADER_UnregisterProgram(reservation->programHandle);
+    reservation->token = 0;
+}
+
+Result LaunchReservations_Reserve(u32 *outToken, const FS_ProgramInfo *programInfo, s64 timeout)
+{
+    Result res = 0;
+    LaunchReservation *reservation = NULL;
+
+    *outToken = 0;
+
+    // The loader IPCs are made with the lock held, but they're what the caller is waiting for anyway
+    LightLock_Lock(&g_launchReservations.lock);
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        LaunchReservation *r = &g_launchReservations.reservations[i];
+        if (r->token != 0 && isSameProgram(&r->programInfo, programInfo)) {
+            reservation = r;
+            break;
+        }
+    }
+
+    if (reservation == NULL) {
+        // Pick a free slot, or replace the reservation that expires first
+        for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+            LaunchReservation *r = &g_launchReservations.reservations[i];
+            if (reservation == NULL || r->token == 0 || (reservation->token != 0 && r->deadline < reservation->deadline)) {
+                reservation = r;
+            }
+        }
+
+        if (reservation->token != 0) {
+            release(reservation);
+        }
+
+        res = registerProgram(&reservation->programHandle, programInfo, programInfo);
+        if (R_SUCCEEDED(res)) {
+            res = LOADER_GetProgramInfo(&reservation->exheaderInfo, reservation->programHandle);
+            res = R_SUCCEEDED(res) && reservation->exheaderInfo.aci.local_caps.core_info.core_version != SYSCOREVER ? (Result)0xC8A05800 : res;
+            if (R_FAILED(res)) {
+                LOADER_UnregisterProgram(reservation->programHandle);
+            }
+        }
+
+        if (R_SUCCEEDED(res)) {
+            reservation->programInfo = *programInfo;
+            reservation->token = g_launchReservations.nextToken;
+            g_launchReservations.nextToken = g_launchReservations.nextToken == 0xFFFFFFFF ? 1 : g_launchReservations.nextToken + 1;
+        }
+    }
+
+    if (R_SUCCEEDED(res)) {
+        reservation->deadline = getDeadline(timeout);
+        *outToken = reservation->token;
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+
+    if (R_SUCCEEDED(res)) {
+        // Have the process monitor thread pick up the new deadline
+        ProcessMonitor_Wake();
+    }
+
+    return res;
+}
+
+Result LaunchReservations_Cancel(u32 token)
+{
+    Result res = 0xD8E05BF4;
+
+    LightLock_Lock(&g_launchReservations.lock);
+    for (u32 i = 0; token != 0 && i < LAUNCHRESERVATIONS_MAX; i++) {
+        if (g_launchReservations.reservations[i].token == token) {
+            release(&g_launchReservations.reservations[i]);
+            res = 0;
+            break;
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+
+    return res;
+}
+
+bool LaunchReservations_Consume(u64 *outProgramHandle, ExHeader_Info *outExheaderInfo, const FS_ProgramInfo *programInfo)
+{
+    bool found = false;
+
+    LightLock_Lock(&g_launchReservations.lock);
+    u64 now = svcGetSystemTick();
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        LaunchReservation *r = &g_launchReservations.reservations[i];
+        if (r->token != 0 && isSameProgram(&r->programInfo, programInfo)) {
+            if (r->deadline <= now) {
+                // The process monitor hasn't released it yet
+                release(r);
+                break;
+            }
+
+            *outProgramHandle = r->programHandle;
+            memcpy(outExheaderInfo, &r->exheaderInfo, sizeof(ExHeader_Info));
+            r->token = 0;
+            found = true;
+            break;
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+
+    return found;
+}
+
+void LaunchReservations_ReleaseExpired(void)
+{
+    LightLock_Lock(&g_launchReservations.lock);
+    u64 now = svcGetSystemTick();
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        LaunchReservation *r = &g_launchReservations.reservations[i];
+        if (r->token != 0 && r->deadline <= now) {
+            release(r);
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+}
+
+void LaunchReservations_HandleMediaNotification(u32 notificationId)
+{
+    FS_MediaType mediaType;
+
+    // The registered title may no longer be there, or may have been replaced
+    switch (notificationId) {
+        case NOTIFICATION_SDCARD_INSERTED:
+        case NOTIFICATION_SDCARD_REMOVED:
+            mediaType = MEDIATYPE_SD;
+            break;
+        case NOTIFICATION_GAMECARD_INSERTED:
+        case NOTIFICATION_GAMECARD_REMOVED:
+            mediaType = MEDIATYPE_GAME_CARD;
+            break;
+        default:
+            return;
+    }
+
+    LightLock_Lock(&g_launchReservations.lock);
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        LaunchReservation *r = &g_launchReservations.reservations[i];
+        if (r->token != 0 && r->programInfo.mediaType == mediaType) {
+            release(r);
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+}
+
+void LaunchReservations_ReleaseAll(void)
+{
+    LightLock_Lock(&g_launchReservations.lock);
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        if (g_launchReservations.reservations[i].token != 0) {
+            release(&g_launchReservations.reservations[i]);
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+}
+
+s64 LaunchReservations_GetTimeout(void)
+{
+    s64 timeout = -1;
+
+    LightLock_Lock(&g_launchReservations.lock);
+    u64 now = svcGetSystemTick();
+    for (u32 i = 0; i < LAUNCHRESERVATIONS_MAX; i++) {
+        LaunchReservation *r = &g_launchReservations.reservations[i];
+        if (r->token != 0) {
+            s64 remaining = (s64)(r->deadline - now);
+            s64 t = remaining > 0 ? ticksToNs(remaining) : 0;
+            timeout = timeout < 0 || t < timeout ? t : timeout;
+        }
+    }
+    LightLock_Unlock(&g_launchReservations.lock);
+
+    return timeout;
+}
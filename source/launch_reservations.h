@@ -0,0 +1,23 @@
+#pragma once
+
+#include <3ds/exheader.h>
+#include <3ds/services/fs.h>
+
+// Titles can be registered with the loader ahead of time (e.g. when HOME menu's cursor hovers an icon), so that the
+// launch itself can go straight to LOADER_LoadProcess.
+
+#define LAUNCHRESERVATIONS_MAX  2
+
+void LaunchReservations_Init(void);
+
+/// Registers the title and reads its exheader. Reserving a title again refreshes its reservation and returns the same token.
+Result LaunchReservations_Reserve(u32 *outToken, const FS_ProgramInfo *programInfo, s64 timeout);
+Result LaunchReservations_Cancel(u32 token);
+
+/// Takes over the reservation of a title, if any and not expired. The caller becomes responsible for the program handle.
+bool LaunchReservations_Consume(u64 *outProgramHandle, ExHeader_Info *outExheaderInfo, const FS_ProgramInfo *programInfo);
+
+void LaunchReservations_ReleaseExpired(void);
+void LaunchReservations_HandleMediaNotification(u32 notificationId); ///< Releases the reservations on the affected media
+void LaunchReservations_ReleaseAll(void);
+s64 LaunchReservations_GetTimeout(void); ///< Time until the next expiry in ns, -1 if there are no reservations
@@ -0,0 +1,45 @@
+#include <3ds.h>
+#include <string.h>
+#include "launch_stats.h"
+
+static LightLock g_launchStatsLock;
+static LaunchStageStats g_launchStats[LAUNCHCATEGORY_COUNT][LAUNCHSTAGE_COUNT];
+
+void LaunchStats_Init(void)
+{
+    memset(g_launchStats, 0, sizeof(g_launchStats));
+    LightLock_Init(&g_launchStatsLock);
+}
+
+void LaunchStats_Record(LaunchCategory category, const u64 *stageTicks, u32 reservedStages)
+{
+    LightLock_Lock(&g_launchStatsLock);
+    for (u32 i = 0; i < LAUNCHSTAGE_COUNT; i++) {
+        LaunchStageStats *stats = &g_launchStats[category][i];
+        u32 ticks = stageTicks[i] > 0xFFFFFFFFULL ? 0xFFFFFFFF : (u32)stageTicks[i];
+
+        if (reservedStages & (1 << i)) {
+            ++stats->numReserved;
+            continue;
+        }
+
+        // Stages that weren't reached (no dependencies, debug-queued processes...) aren't counted
+        if (ticks == 0) {
+            continue;
+        }
+
+        stats->minTicks = stats->count == 0 || ticks < stats->minTicks ? ticks : stats->minTicks;
+        stats->maxTicks = ticks > stats->maxTicks ? ticks : stats->maxTicks;
+        stats->totalTicks += ticks;
+        ++stats->histogram[LaunchStats_GetBucket(ticks)];
+        ++stats->count;
+    }
+    LightLock_Unlock(&g_launchStatsLock);
+}
+
+void LaunchStats_Get(LaunchStageStats *outStats, LaunchCategory category)
+{
+    LightLock_Lock(&g_launchStatsLock);
+    memcpy(outStats, g_launchStats[category], sizeof(g_launchStats[category]));
+    LightLock_Unlock(&g_launchStatsLock);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/exheader.h>
+
+typedef enum LaunchStage {
+    LAUNCHSTAGE_REGISTER_PROGRAM = 0,   ///< registerProgram (may be two loader IPCs on N3DS)
+    LAUNCHSTAGE_GET_PROGRAM_INFO,       ///< LOADER_GetProgramInfo
+    LAUNCHSTAGE_LOAD_PROCESS,           ///< LOADER_LoadProcess
+    LAUNCHSTAGE_FSREG_REGISTER,         ///< FSREG_Register
+    LAUNCHSTAGE_SRVPM_REGISTER,         ///< SRVPM_RegisterProcess
+    LAUNCHSTAGE_DEPENDENCIES,           ///< Launching the missing dependencies
+    LAUNCHSTAGE_RUN,                    ///< svcRun
+
+    LAUNCHSTAGE_COUNT,
+} LaunchStage;
+
+typedef enum LaunchCategory {
+    LAUNCHCATEGORY_APPLICATION = 0,
+    LAUNCHCATEGORY_APPLET,
+    LAUNCHCATEGORY_SYSMODULE,
+
+    LAUNCHCATEGORY_COUNT,
+} LaunchCategory;
+
+/// Bucket i counts the durations in [2^(i+12), 2^(i+13)[ ticks, first and last buckets are open-ended (~15us to ~0.5s)
+#define LAUNCHSTATS_NUM_BUCKETS 16
+
+/// Also used by termination_trace, so that both group processes the same way
+static inline LaunchCategory LaunchStats_GetCategory(u8 reslimitCategory)
+{
+    switch (reslimitCategory) {
+        case RESLIMIT_CATEGORY_APPLICATION: return LAUNCHCATEGORY_APPLICATION;
+        case RESLIMIT_CATEGORY_SYS_APPLET:
+        case RESLIMIT_CATEGORY_LIB_APPLET:  return LAUNCHCATEGORY_APPLET;
+        default:                            return LAUNCHCATEGORY_SYSMODULE;
+    }
+}
+
+static inline u32 LaunchStats_GetBucket(u32 ticks)
+{
+    u32 log2 = ticks == 0 ? 0 : 31 - __builtin_clz(ticks);
+    return log2 < 12 ? 0 : log2 - 12 >= LAUNCHSTATS_NUM_BUCKETS ? LAUNCHSTATS_NUM_BUCKETS - 1 : log2 - 12;
+}
+
+typedef struct LaunchStageStats {
+    u32 count;
+    u32 minTicks;
+    u32 maxTicks;
+    u32 numReserved; ///< launches that skipped this stage thanks to a PrepareLaunch reservation (not in count)
+    u64 totalTicks; ///< Average = totalTicks / count, computed by the client (no 64-bit division here)
+    u32 histogram[LAUNCHSTATS_NUM_BUCKETS];
+} LaunchStageStats;
+
+void LaunchStats_Init(void);
+/// reservedStages: mask of the stages (1 << stage) that a launch reservation made unnecessary
+void LaunchStats_Record(LaunchCategory category, const u64 *stageTicks, u32 reservedStages);
+void LaunchStats_Get(LaunchStageStats *outStats, LaunchCategory category); // LAUNCHSTAGE_COUNT entries
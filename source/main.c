@@ -3,6 +3,13 @@
 #include "manager.h"
 #include "reslimit.h"
 #include "launch.h"
+#include "info.h"
+#include "launch_stats.h"
+#include "title_info_cache.h"
+#include "exit_stats.h"
+#include "termination_trace.h"
+#include "idle_pool.h"
+#include "launch_reservations.h"
 #include "firmlaunch.h"
 #include "exheader_info_heap.h"
 #include "task_runner.h"
@@ -15,6 +22,67 @@
 
 static MyThread processMonitorThread, taskRunnerThread;
 
+// The process pool is sized from PM's own resource limit (the one the KIPs run under, not one of the four PM creates)
+#define MIN_PROCESS_SLOTS   0x40    // what official PM has
+#define MAX_PROCESS_SLOTS   0x100   // not limited by svcWaitSynchronizationN: the process monitor spreads the handles over several threads
+
+// HandleTableSize in 3ds_pm.rsf: one handle per process, and PM's own (threads, events, sessions, reslimits...)
+#define HANDLE_TABLE_SIZE   0x200
+_Static_assert(MAX_PROCESS_SLOTS + 0x80 <= HANDLE_TABLE_SIZE, "3ds_pm.rsf's HandleTableSize is too small for MAX_PROCESS_SLOTS");
+
+static inline size_t getPageAlignedSize(size_t size)
+{
+    return (size + 0xFFF) & ~0xFFF;
+}
+
+static void *allocateHeapPages(size_t size)
+{
+    // We don't use libctru's heap, so just grow our own from the start of the heap region
+    static u32 heapTop = OS_HEAP_AREA_BEGIN;
+    u32 addr;
+
+    size = getPageAlignedSize(size);
+    assertSuccess(svcControlMemory(&addr, heapTop, 0, size, MEMOP_ALLOC, MEMPERM_READ | MEMPERM_WRITE));
+    heapTop += size;
+
+    return (void *)addr;
+}
+
+static u32 getNumProcessSlots(void)
+{
+    static const ResourceLimitType types[2] = { RESLIMIT_COMMIT, RESLIMIT_THREAD };
+    Handle reslimit;
+    s64 limits[2], current[2];
+
+    if (R_FAILED(svcGetResourceLimit(&reslimit, CUR_PROCESS_HANDLE))) {
+        return MIN_PROCESS_SLOTS;
+    }
+
+    Result res = svcGetResourceLimitLimitValues(limits, reslimit, types, 2);
+    if (R_SUCCEEDED(res)) {
+        res = svcGetResourceLimitCurrentValues(current, reslimit, types, 2);
+    }
+    svcCloseHandle(reslimit);
+    if (R_FAILED(res)) {
+        return MIN_PROCESS_SLOTS;
+    }
+
+    // Take at most half of what's left, the other KIPs share that limit. The minimum was static memory before, so
+    // it's used even if it doesn't fit
+    s64 freeMemory = (limits[0] - current[0]) / 2;
+    s64 freeThreads = (limits[1] - current[1]) / 2;
+    u32 num;
+    for (num = MAX_PROCESS_SLOTS; num > MIN_PROCESS_SLOTS; num /= 2) {
+        size_t memory = getPageAlignedSize(PROCESSLIST_BUFFER_SIZE(num)) + getPageAlignedSize(ProcessMonitor_GetBufferSize(num));
+        size_t numThreads = 2 + NUM_DEPENDENCY_LAUNCH_WORKERS + ProcessMonitor_GetNumThreads(num);
+        if ((s64)memory <= freeMemory && (s64)numThreads <= freeThreads) {
+            break;
+        }
+    }
+
+    return num;
+}
+
 // this is called before main
 void __appInit()
 {
@@ -28,14 +96,23 @@ void __appInit()
     loaderInit();
     fsRegInit();
 
-    static u8 ALIGN(8) processDataBuffer[0x40 * sizeof(ProcessData)] = {0};
-    static u8 ALIGN(8) exheaderInfoBuffer[6 * sizeof(ExHeader_Info)] = {0};
-    static u8 ALIGN(8) threadStacks[2][THREAD_STACK_SIZE] = {0};
+    // Each dependency launch worker needs one while working
+    static u8 ALIGN(8) exheaderInfoBuffer[(6 + NUM_DEPENDENCY_LAUNCH_WORKERS) * sizeof(ExHeader_Info)] = {0};
+    static u8 ALIGN(8) threadStacks[2 + NUM_DEPENDENCY_LAUNCH_WORKERS][THREAD_STACK_SIZE] = {0};
 
     // Init objects
-    Manager_Init(processDataBuffer, 0x40);
-    ExHeaderInfoHeap_Init(exheaderInfoBuffer, 6);
+    u32 numProcessSlots = getNumProcessSlots();
+    Manager_Init(allocateHeapPages(PROCESSLIST_BUFFER_SIZE(numProcessSlots)), numProcessSlots);
+    ProcessMonitor_Init(allocateHeapPages(ProcessMonitor_GetBufferSize(numProcessSlots)), numProcessSlots);
+    ExHeaderInfoHeap_Init(exheaderInfoBuffer, 6 + NUM_DEPENDENCY_LAUNCH_WORKERS);
     TaskRunner_Init();
+    LaunchStats_Init();
+    TitleInfoCache_Init();
+    ExitStats_Init();
+    TerminationTrace_Init();
+    initTitleVariantMemo();
+    IdlePool_Init();
+    LaunchReservations_Init();
 
     // Init the reslimits, register the KIPs and map the firmlaunch parameters
     initializeReslimits();
@@ -45,6 +122,7 @@ void __appInit()
     // Create the threads
     assertSuccess(MyThread_Create(&processMonitorThread, processMonitor, NULL, threadStacks[0], THREAD_STACK_SIZE, 0x17, -2));
     assertSuccess(MyThread_Create(&taskRunnerThread, TaskRunner_HandleTasks, NULL, threadStacks[1], THREAD_STACK_SIZE, 0x17, -2));
+    startDependencyLaunchWorkers(threadStacks[2]);
 
     // Launch NS, etc.
     autolaunchSysmodules();
@@ -86,7 +164,18 @@ static const ServiceManagerServiceEntry services[] = {
     { NULL },
 };
 
+static void handleMediaNotification(u32 notificationId)
+{
+    TitleInfoCache_HandleMediaNotification(notificationId);
+    LaunchReservations_HandleMediaNotification(notificationId);
+    clearTitleVariantMemo();
+}
+
 static const ServiceManagerNotificationEntry notifications[] = {
+    { NOTIFICATION_SDCARD_INSERTED,     handleMediaNotification },
+    { NOTIFICATION_SDCARD_REMOVED,      handleMediaNotification },
+    { NOTIFICATION_GAMECARD_INSERTED,   handleMediaNotification },
+    { NOTIFICATION_GAMECARD_REMOVED,    handleMediaNotification },
     { 0x000, NULL },
 };
 
@@ -2,6 +2,8 @@
 #include <string.h>
 #include "manager.h"
 #include "reslimit.h"
+#include "process_monitor.h"
+#include "idle_pool.h"
 #include "util.h"
 
 Manager g_manager;
@@ -10,7 +12,6 @@ void Manager_Init(void *procBuf, size_t numProc)
 {
     memset(&g_manager, 0, sizeof(Manager));
     ProcessList_Init(&g_manager.processList, procBuf, numProc);
-    assertSuccess(svcCreateEvent(&g_manager.newProcessEvent, RESET_ONESHOT));
     assertSuccess(svcCreateEvent(&g_manager.allNotifiedTerminationEvent , RESET_ONESHOT));
 }
 
@@ -24,18 +25,20 @@ void Manager_RegisterKips(void)
 
     ProcessList_Lock(&g_manager.processList);
     for (u32 i = 0; i < (u32)numKips; i++) {
-        process = ProcessList_New(&g_manager.processList);
+        assertSuccess(svcOpenProcess(&processHandle, i));
+
+        // note: same TID for all builtins
+        process = ProcessList_New(&g_manager.processList, processHandle, i, 0x0004000100001000ULL);
         if (process == NULL) {
             panic(1);
         }
 
-        assertSuccess(svcOpenProcess(&processHandle, i));
-        process->handle = processHandle;
-        process->pid = i;
         process->refcount = 1;
-        process->titleId = 0x0004000100001000ULL; // note: same TID for all builtins
-        process->flags = PROCESSFLAG_KIP;
-        process->terminationStatus = TERMSTATUS_RUNNING;
+        ProcessList_SetFlags(&g_manager.processList, process, PROCESSFLAG_KIP);
+        ProcessList_SetTerminationStatus(&g_manager.processList, process, TERMSTATUS_RUNNING);
+        if (!ProcessMonitor_AddProcess(process)) {
+            panic(1);
+        }
 
         assertSuccess(svcSetProcessResourceLimits(processHandle, g_manager.reslimits[RESLIMIT_CATEGORY_OTHER]));
     }
@@ -58,7 +61,15 @@ Result UnregisterProcess(u64 titleId)
             g_manager.debugData = NULL;
         }
 
-        svcCloseHandle(foundProcess->handle);
+        if (ProcessList_GetTerminationStatus(&g_manager.processList, foundProcess) != TERMSTATUS_TERMINATED) {
+            ProcessMonitor_RemoveProcess(foundProcess);
+        }
+
+        if (ProcessList_GetFlags(&g_manager.processList, foundProcess) & PROCESSFLAG_IDLE) {
+            IdlePool_Remove(foundProcess);
+        }
+
+        svcCloseHandle(ProcessList_GetHandle(&g_manager.processList, foundProcess));
         ProcessList_Delete(&g_manager.processList, foundProcess);
     }
 
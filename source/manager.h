@@ -8,7 +8,6 @@ typedef struct Manager {
     ProcessData *runningApplicationData;
     ProcessData *debugData; // note: official PM uses runningApplicationData for both, and has queuedApplicationProcessHandle
     Handle reslimits[4];
-    Handle newProcessEvent;
     Handle allNotifiedTerminationEvent;
     bool waitingForTermination;
     bool preparingForReboot;
@@ -18,6 +17,6 @@ typedef struct Manager {
 
 extern Manager g_manager;
 
-void Manager_Init(void *procBuf, size_t numProc);
+void Manager_Init(void *procBuf, size_t numProc); // procBuf must be PROCESSLIST_BUFFER_SIZE(numProc) bytes
 void Manager_RegisterKips(void);
 Result UnregisterProcess(u64 titleId);
@@ -6,22 +6,23 @@
 #include "info.h"
 #include "reslimit.h"
 #include "manager.h"
+#include "task_runner.h"
+#include "service_manager.h"
+#include "launch_reservations.h"
 #include "util.h"
 
-void pmAppHandleCommands(void *ctx)
+static void handleCommand(u32 *cmdbuf)
 {
-    (void)ctx;
-    u32 *cmdbuf = getThreadCommandBuffer();
     u32 cmdhdr = cmdbuf[0];
 
     FS_ProgramInfo programInfo, programInfoUpdate;
     ExHeader_Arm11CoreInfo coreInfo;
     ExHeader_SystemInfoFlags siFlags;
-    u32 pid;
+    u32 pid, token;
     u64 titleId, mbz;
     s64 timeout, limit;
-    void *buf;
-    size_t size;
+    void *buf, *buf2;
+    size_t size, size2;
 
     switch (cmdhdr >> 16) {
         case 1:
@@ -115,6 +116,63 @@ void pmAppHandleCommands(void *ctx)
             memcpy(&programInfoUpdate, cmdbuf + 5, sizeof(FS_ProgramInfo));
             cmdbuf[1] = LaunchTitleUpdate(&programInfo, &programInfoUpdate, cmdbuf[9]);
             break;
+
+        // Custom commands
+        case 0x100:
+            if (cmdhdr != IPC_MakeHeader(0x100, 1, 4) || (cmdbuf[2] & 0xF) != 0xA || (cmdbuf[4] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[2] >> 4;
+            buf = (void *)cmdbuf[3];
+            size2 = cmdbuf[4] >> 4;
+            buf2 = (void *)cmdbuf[5];
+            if (cmdbuf[1] > size / sizeof(FS_ProgramInfo) || cmdbuf[1] > size2 / sizeof(TitleExHeaderFlags)) {
+                goto invalid_command;
+            }
+            cmdbuf[1] = GetTitleExHeaderFlagsBatch(buf2, buf, cmdbuf[1]);
+            cmdbuf[0] = IPC_MakeHeader(0x100, 1, 4);
+            cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+            cmdbuf[3] = (u32)buf;
+            cmdbuf[4] = IPC_Desc_Buffer(size2, IPC_BUFFER_W);
+            cmdbuf[5] = (u32)buf2;
+            break;
+        case 0x101:
+            memcpy(&programInfo, cmdbuf + 1, sizeof(FS_ProgramInfo));
+            memcpy(&timeout, cmdbuf + 6, 8);
+            cmdbuf[1] = SwitchApplication(&pid, &programInfo, cmdbuf[5], timeout);
+            cmdbuf[2] = pid;
+            cmdbuf[0] = IPC_MakeHeader(0x101, 2, 0);
+            break;
+        case 0x102:
+            memcpy(&programInfo, cmdbuf + 1, sizeof(FS_ProgramInfo));
+            memcpy(&timeout, cmdbuf + 5, 8);
+            cmdbuf[1] = PrepareLaunch(&token, &programInfo, timeout);
+            cmdbuf[2] = token;
+            cmdbuf[0] = IPC_MakeHeader(0x102, 2, 0);
+            break;
+        case 0x103:
+            cmdbuf[1] = LaunchReservations_Cancel(cmdbuf[1]);
+            cmdbuf[0] = IPC_MakeHeader(0x103, 1, 0);
+            break;
+        case 0x104:
+            if (cmdhdr != IPC_MakeHeader(0x104, 3, 4) || (cmdbuf[4] & 0xF) != 0xA || (cmdbuf[6] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            memcpy(&timeout, cmdbuf + 2, 8);
+            size = cmdbuf[4] >> 4;
+            buf = (void *)cmdbuf[5];
+            size2 = cmdbuf[6] >> 4;
+            buf2 = (void *)cmdbuf[7];
+            if (cmdbuf[1] > size / sizeof(TerminationBatchEntry) || cmdbuf[1] > size2 / sizeof(u32)) {
+                goto invalid_command;
+            }
+            cmdbuf[1] = TerminateBatch(buf2, buf, cmdbuf[1], timeout);
+            cmdbuf[0] = IPC_MakeHeader(0x104, 1, 4);
+            cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_R);
+            cmdbuf[3] = (u32)buf;
+            cmdbuf[4] = IPC_Desc_Buffer(size2, IPC_BUFFER_W);
+            cmdbuf[5] = (u32)buf2;
+            break;
         default:
             cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
             cmdbuf[1] = 0xD900182F;
@@ -127,3 +185,122 @@ void pmAppHandleCommands(void *ctx)
     cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
     cmdbuf[1] = 0xD9001830;
 }
+
+static void HandleCommandAsync(void *argdata)
+{
+    struct {
+        u32 token;
+        u32 cmdbuf[15];
+    } *args = argdata;
+
+    handleCommand(args->cmdbuf);
+    ServiceManager_CompleteReply(args->token, args->cmdbuf);
+}
+
+// The buffer descriptors have to be given back to the client, as in the success path
+static void makeErrorReply(u32 *cmdbuf, Result res)
+{
+    u32 numNormal = (cmdbuf[0] >> 6) & 0x3F;
+    u32 numTranslate = cmdbuf[0] & 0x3F;
+
+    for (u32 i = 0; i < numTranslate; i += 2) {
+        if (i + 1 >= numTranslate || (cmdbuf[1 + numNormal + i] & 0x9) != 0x8) {
+            cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
+            cmdbuf[1] = 0xD9001830;
+            return;
+        }
+    }
+
+    memmove(cmdbuf + 2, cmdbuf + 1 + numNormal, 4 * numTranslate);
+    cmdbuf[0] = IPC_MakeHeader(cmdbuf[0] >> 16, 1, numTranslate);
+    cmdbuf[1] = res;
+}
+
+static bool tryGetCachedTitleExHeaderFlags(u32 *cmdbuf)
+{
+    FS_ProgramInfo programInfo;
+    ExHeader_Arm11CoreInfo coreInfo;
+    ExHeader_SystemInfoFlags siFlags;
+    Result res;
+
+    memcpy(&programInfo, cmdbuf + 1, sizeof(FS_ProgramInfo));
+    if (!TryGetCachedTitleExHeaderFlags(&res, &coreInfo, &siFlags, &programInfo)) {
+        return false;
+    }
+
+    cmdbuf[1] = res;
+    cmdbuf[0] = IPC_MakeHeader(8, 5, 0);
+    memcpy(cmdbuf + 2, &coreInfo, sizeof(ExHeader_Arm11CoreInfo));
+    memcpy(cmdbuf + 4, &siFlags, sizeof(ExHeader_SystemInfoFlags));
+    return true;
+}
+
+static bool deferCommand(const u32 *cmdbuf)
+{
+    struct {
+        u32 token;
+        u32 cmdbuf[15];
+    } args;
+
+    // Buffer mappings stay valid until the reply is sent
+    u32 numParams = ((cmdbuf[0] >> 6) & 0x3F) + (cmdbuf[0] & 0x3F);
+    if (numParams >= 15) {
+        return false;
+    }
+
+    args.token = ServiceManager_DeferReply();
+    if (args.token == 0) {
+        return false;
+    }
+
+    memcpy(args.cmdbuf, cmdbuf, 4 * (1 + numParams));
+    if (R_FAILED(TaskRunner_RunTask(HandleCommandAsync, &args, sizeof(args)))) {
+        // Queue full: reply with the error right away, through the deferred path
+        makeErrorReply(args.cmdbuf, 0xC8605BF0);
+        ServiceManager_CompleteReply(args.token, args.cmdbuf);
+    }
+
+    return true;
+}
+
+void pmAppHandleCommands(void *ctx)
+{
+    (void)ctx;
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    switch (cmdbuf[0] >> 16) {
+        // Commands that can block for a long time (loader IPCs, termination timeouts) are run on the task runner
+        // thread, and replied to when done, so that other sessions keep being serviced.
+        case 1: // LaunchTitle
+            // Applications are already launched on the task runner thread, deferring them would take a second
+            // queue slot
+            if ((cmdbuf[5] & PMLAUNCHFLAG_NORMAL_APPLICATION) && !(cmdbuf[5] & PMLAUNCHFLAG_QUEUE_DEBUG_APPLICATION)) {
+                break;
+            }
+            if (deferCommand(cmdbuf)) {
+                return;
+            }
+            break;
+        case 8: // GetTitleExHeaderFlags
+            if (tryGetCachedTitleExHeaderFlags(cmdbuf)) {
+                return;
+            }
+            if (deferCommand(cmdbuf)) {
+                return;
+            }
+            break;
+        case 3: // TerminateApplication
+        case 0x100: // GetTitleExHeaderFlagsBatch
+        case 0x101: // SwitchApplication
+        case 0x102: // PrepareLaunch
+        case 0x104: // TerminateBatch
+            if (deferCommand(cmdbuf)) {
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    handleCommand(cmdbuf);
+}
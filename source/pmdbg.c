@@ -1,6 +1,15 @@
 #include <3ds.h>
 #include <string.h>
 #include "launch.h"
+#include "task_runner.h"
+#include "launch_stats.h"
+#include "title_info_cache.h"
+#include "idle_pool.h"
+#include "termination.h"
+#include "exit_stats.h"
+#include "termination_trace.h"
+#include "process_monitor.h"
+#include "manager.h"
 #include "util.h"
 
 void pmDbgHandleCommands(void *ctx)
@@ -11,6 +20,19 @@ void pmDbgHandleCommands(void *ctx)
 
     FS_ProgramInfo programInfo;
     Handle debug;
+    TaskRunnerStats taskRunnerStats;
+    u32 queueDepth;
+    LaunchStageStats launchStats[LAUNCHSTAGE_COUNT];
+    TitleInfoCacheStats titleInfoCacheStats;
+    IdlePoolStats idlePoolStats;
+    s64 gracePeriod;
+    ShutdownStats shutdownStats;
+    ExitStatsTitleInfo exitStatsInfo;
+    u64 titleId;
+    TerminationTraceStats terminationTraceStats[TERMINATIONTRACE_INTERVAL_COUNT];
+    ProcessMonitorStats processMonitorStats;
+    void *buf;
+    size_t size;
 
     switch (cmdhdr >> 16) {
         case 1:
@@ -33,9 +55,133 @@ void pmDbgHandleCommands(void *ctx)
             cmdbuf[2] = IPC_Desc_MoveHandles(1);
             cmdbuf[3] = debug;
             break;
+
+        // Custom commands
+        case 0x100:
+            TaskRunner_GetStats(&taskRunnerStats, &queueDepth);
+            cmdbuf[1] = 0;
+            cmdbuf[2] = queueDepth;
+            cmdbuf[3] = taskRunnerStats.maxQueueDepth;
+            cmdbuf[4] = taskRunnerStats.numTasksRun;
+            cmdbuf[5] = taskRunnerStats.numTasksRejected;
+            memcpy(cmdbuf + 6, &taskRunnerStats.totalWaitTicks, 8);
+            memcpy(cmdbuf + 8, &taskRunnerStats.maxWaitTicks, 8);
+            cmdbuf[0] = IPC_MakeHeader(0x100, 9, 0);
+            break;
+        case 0x101:
+            if (cmdhdr != IPC_MakeHeader(0x101, 1, 2) || (cmdbuf[2] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[2] >> 4;
+            buf = (void *)cmdbuf[3];
+            if (cmdbuf[1] >= LAUNCHCATEGORY_COUNT) {
+                cmdbuf[1] = 0xD8E05BF4;
+            } else {
+                LaunchStats_Get(launchStats, (LaunchCategory)cmdbuf[1]);
+                memcpy(buf, launchStats, size > sizeof(launchStats) ? sizeof(launchStats) : size);
+                cmdbuf[1] = 0;
+            }
+            cmdbuf[0] = IPC_MakeHeader(0x101, 1, 2);
+            cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[3] = (u32)buf;
+            break;
+        case 0x102:
+            TitleInfoCache_GetStats(&titleInfoCacheStats);
+            cmdbuf[1] = 0;
+            cmdbuf[2] = titleInfoCacheStats.numHits;
+            cmdbuf[3] = titleInfoCacheStats.numMisses;
+            cmdbuf[4] = titleInfoCacheStats.numInvalidations;
+            cmdbuf[0] = IPC_MakeHeader(0x102, 4, 0);
+            break;
+        case 0x103:
+            memcpy(&gracePeriod, cmdbuf + 1, 8);
+            IdlePool_SetGracePeriod(gracePeriod);
+            cmdbuf[1] = 0;
+            cmdbuf[0] = IPC_MakeHeader(0x103, 1, 0);
+            break;
+        case 0x104:
+            IdlePool_GetStats(&idlePoolStats);
+            cmdbuf[1] = 0;
+            memcpy(cmdbuf + 2, &idlePoolStats, sizeof(IdlePoolStats));
+            cmdbuf[0] = IPC_MakeHeader(0x104, 1 + sizeof(IdlePoolStats) / 4, 0);
+            break;
+        case 0x105:
+            if (cmdhdr != IPC_MakeHeader(0x105, 0, 2) || (cmdbuf[1] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[1] >> 4;
+            buf = (void *)cmdbuf[2];
+            getLastShutdownStats(&shutdownStats);
+            memcpy(buf, &shutdownStats, size > sizeof(shutdownStats) ? sizeof(shutdownStats) : size);
+            cmdbuf[1] = 0;
+            cmdbuf[0] = IPC_MakeHeader(0x105, 1, 2);
+            cmdbuf[2] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[3] = (u32)buf;
+            break;
+        case 0x106:
+            ExitStats_SetAdaptive(cmdbuf[1] != 0);
+            cmdbuf[1] = 0;
+            cmdbuf[0] = IPC_MakeHeader(0x106, 1, 0);
+            break;
+        case 0x107:
+            memcpy(&titleId, cmdbuf + 1, 8);
+            memset(&exitStatsInfo, 0, sizeof(ExitStatsTitleInfo));
+            cmdbuf[1] = ExitStats_GetTitleInfo(&exitStatsInfo, titleId) ? 0 : 0xD8E05BF4;
+            memcpy(cmdbuf + 2, &exitStatsInfo, sizeof(ExitStatsTitleInfo));
+            cmdbuf[0] = IPC_MakeHeader(0x107, 1 + sizeof(ExitStatsTitleInfo) / 4, 0);
+            break;
+        case 0x108:
+            if (cmdhdr != IPC_MakeHeader(0x108, 0, 2) || (cmdbuf[1] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[1] >> 4;
+            buf = (void *)cmdbuf[2];
+            cmdbuf[2] = TerminationTrace_GetRecords(buf, size / sizeof(TerminationTraceRecord));
+            cmdbuf[1] = 0;
+            cmdbuf[0] = IPC_MakeHeader(0x108, 2, 2);
+            cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[4] = (u32)buf;
+            break;
+        case 0x109:
+            if (cmdbuf[1] >= LAUNCHCATEGORY_COUNT) {
+                cmdbuf[1] = 0xD8E05BF4;
+                cmdbuf[0] = IPC_MakeHeader(0x109, 1, 0);
+            } else {
+                TerminationTrace_GetStats(terminationTraceStats, (LaunchCategory)cmdbuf[1]);
+                cmdbuf[1] = 0;
+                memcpy(cmdbuf + 2, terminationTraceStats, sizeof(terminationTraceStats));
+                cmdbuf[0] = IPC_MakeHeader(0x109, 1 + sizeof(terminationTraceStats) / 4, 0);
+            }
+            break;
+        case 0x10A:
+            ProcessMonitor_GetStats(&processMonitorStats);
+            cmdbuf[1] = 0;
+            memcpy(cmdbuf + 2, &processMonitorStats, sizeof(ProcessMonitorStats));
+            cmdbuf[0] = IPC_MakeHeader(0x10A, 1 + sizeof(ProcessMonitorStats) / 4, 0);
+            break;
+#ifdef LOCK_PROFILING
+        case 0x10B:
+            if (cmdhdr != IPC_MakeHeader(0x10B, 0, 2) || (cmdbuf[1] & 0xF) != 0xC) {
+                goto invalid_command;
+            }
+            size = cmdbuf[1] >> 4;
+            buf = (void *)cmdbuf[2];
+            cmdbuf[2] = ProcessList_GetLockProfile(&g_manager.processList, buf, size / sizeof(ProcessListLockProfile));
+            cmdbuf[1] = 0;
+            cmdbuf[0] = IPC_MakeHeader(0x10B, 2, 2);
+            cmdbuf[3] = IPC_Desc_Buffer(size, IPC_BUFFER_W);
+            cmdbuf[4] = (u32)buf;
+            break;
+#endif
         default:
             cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
             cmdbuf[1] = 0xD900182F;
             break;
     }
+
+    return;
+
+    invalid_command:
+    cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
+    cmdbuf[1] = 0xD9001830;
 }
@@ -1,50 +1,372 @@
 #include <3ds.h>
 #include <string.h>
 #include "process_data.h"
+#include "idle_pool.h"
 #include "util.h"
 
-ProcessData *ProcessList_FindProcessById(const ProcessList *list, u32 pid)
+// Only reads the dense per-slot arrays, not ProcessData
+static inline u64 getIndexKey(const ProcessList *list, u32 kind, u16 id)
+{
+    switch (kind) {
+        case PROCESSINDEX_PID:      return list->pids[id];
+        case PROCESSINDEX_HANDLE:   return list->handles[id];
+        default:                    return list->titleIdKeys[id];
+    }
+}
+
+static inline u32 hashIndexKey(const ProcessList *list, u32 kind, u64 key)
 {
-    ProcessData *process;
+    if (kind == PROCESSINDEX_PID) {
+        // PIDs are allocated sequentially by the kernel: direct mapping
+        return (u32)key & ((1u << list->indexBits) - 1);
+    } else {
+        // Fibonacci hashing, no division
+        return (((u32)key ^ (u32)(key >> 32)) * 0x9E3779B1u) >> (32 - list->indexBits);
+    }
+}
 
-    FOREACH_PROCESS(list, process) {
-        if (process->pid == pid) {
-            return process;
+static ProcessData *findIndexed(const ProcessList *list, u32 kind, u64 key)
+{
+    const u16 *index = list->indexes[kind];
+    u32 mask = (1u << list->indexBits) - 1;
+
+    for (u32 pos = hashIndexKey(list, kind, key); index[pos] != PROCESSINDEX_EMPTY; pos = (pos + 1) & mask) {
+        if (getIndexKey(list, kind, index[pos]) == key) {
+            return &list->pool[index[pos]];
         }
     }
 
     return NULL;
 }
 
-ProcessData *ProcessList_FindProcessByHandle(const ProcessList *list, Handle handle)
+static void insertIndexed(ProcessList *list, u32 kind, ProcessData *process)
 {
-    ProcessData *process;
+    u16 *index = list->indexes[kind];
+    u32 mask = (1u << list->indexBits) - 1;
+    u16 id = (u16)(process - list->pool);
+    u64 key = getIndexKey(list, kind, id);
 
-    FOREACH_PROCESS(list, process) {
-        if (process->handle == handle) {
-            return process;
+    u32 pos;
+    for (pos = hashIndexKey(list, kind, key); index[pos] != PROCESSINDEX_EMPTY; pos = (pos + 1) & mask) {
+        if (kind == PROCESSINDEX_TITLEID && getIndexKey(list, kind, index[pos]) == key) {
+            ProcessData *other = &list->pool[index[pos]];
+            // Keep list order: append to the chain of processes sharing this titleId
+            while (other->nextSameTitleId != PROCESSINDEX_EMPTY) {
+                other = &list->pool[other->nextSameTitleId];
+            }
+            other->nextSameTitleId = id;
+            return;
         }
     }
 
-    return NULL;
+    index[pos] = id;
 }
 
-ProcessData *ProcessList_FindProcessByTitleId(const ProcessList *list, u64 titleId)
+static void eraseIndexed(ProcessList *list, u32 kind, ProcessData *process)
 {
-    ProcessData *process;
+    u16 *index = list->indexes[kind];
+    u32 mask = (1u << list->indexBits) - 1;
+    u16 id = (u16)(process - list->pool);
+    u64 key = getIndexKey(list, kind, id);
 
-    FOREACH_PROCESS(list, process) {
-        if ((process->titleId & ~0xFFULL) == (titleId & ~0xFFULL)) {
-            return process;
+    u32 pos;
+    for (pos = hashIndexKey(list, kind, key); index[pos] != PROCESSINDEX_EMPTY; pos = (pos + 1) & mask) {
+        if (index[pos] == id) {
+            break;
+        } else if (kind == PROCESSINDEX_TITLEID && getIndexKey(list, kind, index[pos]) == key) {
+            ProcessData *other = &list->pool[index[pos]];
+            // Not the head of its titleId chain, just unlink it
+            while (other->nextSameTitleId != id) {
+                other = &list->pool[other->nextSameTitleId];
+            }
+            other->nextSameTitleId = process->nextSameTitleId;
+            return;
         }
     }
 
-    return NULL;
+    if (index[pos] == PROCESSINDEX_EMPTY) {
+        return;
+    }
+
+    if (kind == PROCESSINDEX_TITLEID && process->nextSameTitleId != PROCESSINDEX_EMPTY) {
+        // Same key, same slot
+        index[pos] = process->nextSameTitleId;
+        return;
+    }
+
+    // Backward-shift deletion, so that we don't need tombstones
+    u32 hole = pos;
+    for (pos = (pos + 1) & mask; index[pos] != PROCESSINDEX_EMPTY; pos = (pos + 1) & mask) {
+        u32 home = hashIndexKey(list, kind, getIndexKey(list, kind, index[pos]));
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            index[hole] = index[pos];
+            hole = pos;
+        }
+    }
+
+    index[hole] = PROCESSINDEX_EMPTY;
+}
+
+static inline u32 getThreadTag(void)
+{
+    // Same as RecursiveLock
+    return (u32)getThreadLocalStorage();
+}
+
+#ifdef LOCK_PROFILING
+// Needs lock->lock. writerDepth is 0 for readers, numReaders 0 for the writer
+static void recordAcquisition(ProcessListLock *lock, ProcessListLockSite *site, u64 startTick, bool contended, bool shared,
+    u32 writerDepth, u32 numReaders)
+{
+    u64 acquiredTick = svcGetSystemTick();
+    u32 waitTicks = acquiredTick - startTick > 0xFFFFFFFFULL ? 0xFFFFFFFF : (u32)(acquiredTick - startTick);
+
+    if (site->numAcquires == 0 && site->numShared == 0) {
+        site->next = lock->sites;
+        lock->sites = site;
+    }
+
+    if (shared) {
+        ++site->numShared;
+    } else {
+        ++site->numAcquires;
+    }
+
+    site->numContended += contended ? 1 : 0;
+    site->maxDepth = writerDepth > site->maxDepth ? writerDepth : site->maxDepth;
+    site->maxConcurrentReaders = numReaders > site->maxConcurrentReaders ? numReaders : site->maxConcurrentReaders;
+    site->maxWaitTicks = waitTicks > site->maxWaitTicks ? waitTicks : site->maxWaitTicks;
+    site->totalWaitTicks += waitTicks;
+
+    if (!shared && writerDepth == 1) {
+        lock->holdSite = site;
+        lock->holdStartTick = acquiredTick;
+    } else if (shared && writerDepth == 0) {
+        for (u32 i = 0; i < PROCESSLIST_PROFILED_READERS; i++) {
+            if (lock->readerHolds[i].tag == 0) {
+                lock->readerHolds[i].tag = getThreadTag();
+                lock->readerHolds[i].site = site;
+                lock->readerHolds[i].startTick = acquiredTick;
+                break;
+            }
+        }
+    }
+}
+
+static inline u64 getHoldTicks(u64 startTick, u32 *outHoldTicks32)
+{
+    u64 holdTicks = svcGetSystemTick() - startTick;
+    *outHoldTicks32 = holdTicks > 0xFFFFFFFFULL ? 0xFFFFFFFF : (u32)holdTicks;
+    return holdTicks;
 }
 
-Result ProcessData_Notify(const ProcessData *process, u32 notificationId)
+// Needs lock->lock
+static void recordRelease(ProcessListLock *lock)
 {
-    Result res = SRVPM_PublishToProcess(notificationId, process->handle);
+    ProcessListLockSite *site = lock->holdSite;
+    u32 holdTicks32;
+    u64 holdTicks = getHoldTicks(lock->holdStartTick, &holdTicks32);
+
+    site->maxHoldTicks = holdTicks32 > site->maxHoldTicks ? holdTicks32 : site->maxHoldTicks;
+    site->totalHoldTicks += holdTicks;
+    lock->holdSite = NULL;
+}
+
+// Needs lock->lock
+static void recordSharedRelease(ProcessListLock *lock)
+{
+    u32 tag = getThreadTag();
+
+    for (u32 i = 0; i < PROCESSLIST_PROFILED_READERS; i++) {
+        ProcessListReaderHold *hold = &lock->readerHolds[i];
+        if (hold->tag == tag) {
+            u32 holdTicks32;
+            u64 holdTicks = getHoldTicks(hold->startTick, &holdTicks32);
+
+            hold->site->maxSharedHoldTicks = holdTicks32 > hold->site->maxSharedHoldTicks ? holdTicks32 : hold->site->maxSharedHoldTicks;
+            hold->site->totalSharedHoldTicks += holdTicks;
+            hold->tag = 0;
+            break;
+        }
+    }
+}
+#endif
+
+static void lockExclusive(ProcessList *list, void *site)
+{
+    ProcessListLock *lock = &list->lock;
+    u32 tag = getThreadTag();
+    bool contended = false;
+#ifdef LOCK_PROFILING
+    u64 startTick = svcGetSystemTick();
+#else
+    (void)site;
+#endif
+
+    LightLock_Lock(&lock->lock);
+    if (lock->writerTag != tag) {
+        if (lock->writerDepth > 0 || lock->numReaders > 0) {
+            contended = true;
+            ++lock->numWaitingWriters;
+            do {
+                CondVar_Wait(&lock->released, &lock->lock);
+            } while (lock->writerDepth > 0 || lock->numReaders > 0);
+            --lock->numWaitingWriters;
+        }
+        lock->writerTag = tag;
+    }
+    ++lock->writerDepth;
+#ifdef LOCK_PROFILING
+    recordAcquisition(lock, site, startTick, contended, false, lock->writerDepth, 0);
+#else
+    (void)contended;
+#endif
+    LightLock_Unlock(&lock->lock);
+}
+
+static void lockShared(ProcessList *list, void *site)
+{
+    ProcessListLock *lock = &list->lock;
+    u32 tag = getThreadTag();
+    bool contended = false;
+    u32 writerDepth = 0, numReaders = 0;
+#ifdef LOCK_PROFILING
+    u64 startTick = svcGetSystemTick();
+#else
+    (void)site;
+#endif
+
+    LightLock_Lock(&lock->lock);
+    if (lock->writerTag == tag) {
+        writerDepth = ++lock->writerDepth;
+    } else {
+        // Queue behind waiting writers: readers overlapping each other would otherwise keep them out indefinitely
+        while (lock->writerDepth > 0 || lock->numWaitingWriters > 0) {
+            contended = true;
+            CondVar_Wait(&lock->released, &lock->lock);
+        }
+        numReaders = ++lock->numReaders;
+    }
+#ifdef LOCK_PROFILING
+    recordAcquisition(lock, site, startTick, contended, true, writerDepth, numReaders);
+#else
+    (void)contended;
+    (void)writerDepth;
+    (void)numReaders;
+#endif
+    LightLock_Unlock(&lock->lock);
+}
+
+static inline void releaseExclusive(ProcessListLock *lock)
+{
+    if (--lock->writerDepth == 0) {
+#ifdef LOCK_PROFILING
+        if (lock->holdSite != NULL) {
+            recordRelease(lock);
+        }
+#endif
+        lock->writerTag = 0;
+        CondVar_Broadcast(&lock->released);
+    }
+}
+
+#ifdef LOCK_PROFILING
+void ProcessList_LockProfiled(ProcessList *list, ProcessListLockSite *site)
+{
+    lockExclusive(list, site);
+}
+
+void ProcessList_LockSharedProfiled(ProcessList *list, ProcessListLockSite *site)
+{
+    lockShared(list, site);
+}
+
+u32 ProcessList_GetLockProfile(ProcessList *list, ProcessListLockProfile *outProfiles, u32 maxProfiles)
+{
+    u32 num = 0;
+
+    LightLock_Lock(&list->lock.lock);
+    for (ProcessListLockSite *site = list->lock.sites; site != NULL && num < maxProfiles; site = site->next) {
+        ProcessListLockProfile *profile = &outProfiles[num++];
+        const char *basename = strrchr(site->file, '/');
+        basename = basename != NULL ? basename + 1 : site->file;
+
+        memset(profile, 0, sizeof(ProcessListLockProfile));
+        strncpy(profile->file, basename, sizeof(profile->file) - 1);
+        profile->line = site->line;
+        profile->numAcquires = site->numAcquires;
+        profile->numShared = site->numShared;
+        profile->numContended = site->numContended;
+        profile->maxDepth = site->maxDepth;
+        profile->maxConcurrentReaders = site->maxConcurrentReaders;
+        profile->maxWaitTicks = site->maxWaitTicks;
+        profile->maxHoldTicks = site->maxHoldTicks;
+        profile->maxSharedHoldTicks = site->maxSharedHoldTicks;
+        profile->totalWaitTicks = site->totalWaitTicks;
+        profile->totalHoldTicks = site->totalHoldTicks;
+        profile->totalSharedHoldTicks = site->totalSharedHoldTicks;
+    }
+    LightLock_Unlock(&list->lock.lock);
+
+    return num;
+}
+#else
+void ProcessList_Lock(ProcessList *list)
+{
+    lockExclusive(list, NULL);
+}
+
+void ProcessList_LockShared(ProcessList *list)
+{
+    lockShared(list, NULL);
+}
+#endif
+
+void ProcessList_Unlock(ProcessList *list)
+{
+    ProcessListLock *lock = &list->lock;
+
+    LightLock_Lock(&lock->lock);
+    releaseExclusive(lock);
+    LightLock_Unlock(&lock->lock);
+}
+
+void ProcessList_UnlockShared(ProcessList *list)
+{
+    ProcessListLock *lock = &list->lock;
+
+    LightLock_Lock(&lock->lock);
+    if (lock->writerTag == getThreadTag()) {
+        releaseExclusive(lock);
+    } else {
+#ifdef LOCK_PROFILING
+        recordSharedRelease(lock);
+#endif
+        if (--lock->numReaders == 0) {
+            CondVar_Broadcast(&lock->released);
+        }
+    }
+    LightLock_Unlock(&lock->lock);
+}
+
+ProcessData *ProcessList_FindProcessById(const ProcessList *list, u32 pid)
+{
+    return findIndexed(list, PROCESSINDEX_PID, pid);
+}
+
+ProcessData *ProcessList_FindProcessByHandle(const ProcessList *list, Handle handle)
+{
+    return findIndexed(list, PROCESSINDEX_HANDLE, handle);
+}
+
+ProcessData *ProcessList_FindProcessByTitleId(const ProcessList *list, u64 titleId)
+{
+    return findIndexed(list, PROCESSINDEX_TITLEID, titleId & ~0xFFULL);
+}
+
+Result ProcessList_Notify(const ProcessList *list, const ProcessData *process, u32 notificationId)
+{
+    Result res = SRVPM_PublishToProcess(notificationId, ProcessList_GetHandle(list, process));
     if (res == (Result)0xD8606408) {
         panic(res);
     }
@@ -52,39 +374,394 @@ Result ProcessData_Notify(const ProcessData *process, u32 notificationId)
     return res;
 }
 
-Result ProcessData_SendTerminationNotification(ProcessData *process)
+static inline void resetTerminationState(ProcessColdData *cold)
+{
+    cold->terminationNotifiedTick = svcGetSystemTick();
+    cold->forceTerminated = false;
+    cold->batchEntry = 0;
+    cold->adaptiveDeadline = false;
+}
+
+Result ProcessList_SendTerminationNotification(ProcessList *list, ProcessData *process)
+{
+    Result res = ProcessList_Notify(list, process, 0x100);
+    ProcessList_SetTerminationStatus(list, process, R_SUCCEEDED(res) ? TERMSTATUS_NOTIFICATION_SENT : TERMSTATUS_NOTIFICATION_FAILED);
+    resetTerminationState(ProcessList_GetColdData(list, process));
+    return res;
+}
+
+void ProcessList_PrepareTerminationNotification(ProcessList *list, ProcessData *process, PendingTermination *outPending)
+{
+    outPending->ref = ProcessList_GetRef(list, process);
+    assertSuccess(svcDuplicateHandle(&outPending->handle, ProcessList_GetHandle(list, process)));
+
+    ProcessList_SetTerminationStatus(list, process, TERMSTATUS_NOTIFICATION_SENT);
+    resetTerminationState(ProcessList_GetColdData(list, process));
+}
+
+Result ProcessList_SendPendingTerminationNotifications(ProcessList *list, const PendingTermination *pending, u32 numPending)
 {
-    Result res = ProcessData_Notify(process, 0x100);
-    process->terminationStatus = R_SUCCEEDED(res) ? TERMSTATUS_NOTIFICATION_SENT : TERMSTATUS_NOTIFICATION_FAILED;
+    Result res = 0;
+
+    for (u32 i = 0; i < numPending; i++) {
+        Result notifyRes = SRVPM_PublishToProcess(0x100, pending[i].handle);
+        if (notifyRes == (Result)0xD8606408) {
+            panic(notifyRes);
+        }
+
+        if (R_FAILED(notifyRes)) {
+            ProcessList_Lock(list);
+            ProcessData *process = ProcessList_ResolveRef(list, pending[i].ref);
+            if (process != NULL && ProcessList_GetTerminationStatus(list, process) == TERMSTATUS_NOTIFICATION_SENT) {
+                ProcessList_SetTerminationStatus(list, process, TERMSTATUS_NOTIFICATION_FAILED);
+            }
+            ProcessList_Unlock(list);
+
+            res = R_SUMMARY(notifyRes) == RS_NOTFOUND ? 0 : notifyRes;
+            if (R_FAILED(res)) {
+                assertSuccess(svcTerminateProcess(pending[i].handle));
+            }
+        }
+
+        svcCloseHandle(pending[i].handle);
+    }
+
     return res;
 }
 
-void ProcessData_Incref(ProcessData *process, u32 amount)
+void ProcessList_Incref(ProcessList *list, ProcessData *process, u32 amount)
 {
-    if (process->flags & PROCESSFLAG_AUTOLOADED) {
+    u8 flags = ProcessList_GetFlags(list, process);
+    if (flags & PROCESSFLAG_AUTOLOADED) {
         if (process->refcount + amount > 0xFF) {
             panic(3);
         }
 
         process->refcount += amount;
+        if (amount > 0 && (flags & PROCESSFLAG_IDLE)) {
+            IdlePool_Revive(process);
+        }
     }
 }
 
-ProcessData *ProcessList_New(ProcessList *list)
+void ProcessList_Init(ProcessList *list, void *buf, size_t num)
 {
-    if (IntrusiveList_TestEnd(&list->freeList, list->freeList.first)) {
+    u32 bits;
+    for (bits = 1; (1u << bits) < 2 * num; bits++);
+
+    LightLock_Init(&list->lock.lock);
+    CondVar_Init(&list->lock.released);
+    list->lock.writerTag = 0;
+    list->lock.writerDepth = 0;
+    list->lock.numReaders = 0;
+    list->lock.numWaitingWriters = 0;
+#ifdef LOCK_PROFILING
+    list->lock.sites = NULL;
+    list->lock.holdSite = NULL;
+    memset(list->lock.readerHolds, 0, sizeof(list->lock.readerHolds));
+#endif
+
+    list->pool = (ProcessData *)buf;
+    list->cold = (ProcessColdData *)(list->pool + num);
+    list->slots = (ProcessSlot *)(list->cold + num);
+    list->titleIdKeys = (u64 *)(list->slots + num);
+    list->handles = (Handle *)(list->titleIdKeys + num);
+    list->pids = (u32 *)(list->handles + num);
+    list->first = PROCESSINDEX_EMPTY;
+    list->last = PROCESSINDEX_EMPTY;
+    list->freeSlot = 0;
+    memset(list->slots, 0, num * sizeof(ProcessSlot));
+    for (u32 i = 0; i < num; i++) {
+        list->slots[i].next = i + 1 < num ? i + 1 : PROCESSINDEX_EMPTY;
+    }
+
+    list->dependencyChunks = (DependencyChunk *)(list->pids + num);
+    list->freeDependencyChunk = 0;
+    for (u32 i = 0; i < num; i++) {
+        list->dependencyChunks[i].next = i + 1 < num ? i + 1 : PROCESSINDEX_EMPTY;
+    }
+
+    list->indexBits = bits;
+    for (u32 i = 0; i < PROCESSINDEX_COUNT; i++) {
+        list->indexes[i] = (u16 *)(list->dependencyChunks + num) + (i << bits);
+        memset(list->indexes[i], 0xFF, sizeof(u16) << bits);
+    }
+
+    list->deadlineHeap = list->indexes[PROCESSINDEX_COUNT - 1] + (1u << bits);
+    list->deadlineHeapSize = 0;
+}
+
+ProcessData *ProcessList_New(ProcessList *list, Handle handle, u32 pid, u64 titleId)
+{
+    u16 id = list->freeSlot;
+    if (id == PROCESSINDEX_EMPTY) {
         return NULL;
     }
 
-    IntrusiveNode *nd = list->freeList.first;
-    IntrusiveList_Erase(nd);
-    memset(nd, 0, sizeof(ProcessData));
-    IntrusiveList_InsertAfter(list->list.last, nd);
-    return (ProcessData *)nd;
+    // Append to the list
+    ProcessSlot *slot = &list->slots[id];
+    list->freeSlot = slot->next;
+    slot->next = PROCESSINDEX_EMPTY;
+    slot->prev = list->last;
+    slot->terminationStatus = TERMSTATUS_RUNNING;
+    slot->flags = 0;
+    if (list->last != PROCESSINDEX_EMPTY) {
+        list->slots[list->last].next = id;
+    } else {
+        list->first = id;
+    }
+    list->last = id;
+
+    list->titleIdKeys[id] = titleId & ~0xFFULL;
+    list->handles[id] = handle;
+    list->pids[id] = pid;
+
+    ProcessData *process = &list->pool[id];
+    memset(process, 0, sizeof(ProcessData));
+    process->titleId = titleId;
+    process->nextSameTitleId = PROCESSINDEX_EMPTY;
+    process->dependencyChunk = PROCESSINDEX_EMPTY;
+    process->reslimitCategory = RESLIMIT_CATEGORY_OTHER;
+
+    memset(&list->cold[id], 0, sizeof(ProcessColdData));
+    list->cold[id].deadlineHeapSlot = PROCESSINDEX_EMPTY;
+    for (u32 i = 0; i < PROCESSINDEX_COUNT; i++) {
+        insertIndexed(list, i, process);
+    }
+
+    return process;
 }
 
 void ProcessList_Delete(ProcessList *list, ProcessData *process)
 {
-    IntrusiveList_Erase(&process->node);
-    IntrusiveList_InsertAfter(list->freeList.first, &process->node);
+    ProcessList_ClearTerminationDeadline(list, process);
+    ProcessList_FreeDependencies(list, process);
+    for (u32 i = 0; i < PROCESSINDEX_COUNT; i++) {
+        eraseIndexed(list, i, process);
+    }
+
+    u16 id = (u16)ProcessList_GetSlotIndex(list, process);
+    ProcessSlot *slot = &list->slots[id];
+    if (slot->prev != PROCESSINDEX_EMPTY) {
+        list->slots[slot->prev].next = slot->next;
+    } else {
+        list->first = slot->next;
+    }
+    if (slot->next != PROCESSINDEX_EMPTY) {
+        list->slots[slot->next].prev = slot->prev;
+    } else {
+        list->last = slot->prev;
+    }
+
+    // Invalidates the references to this process
+    ++slot->generation;
+    slot->prev = PROCESSINDEX_EMPTY;
+    slot->next = list->freeSlot;
+    list->freeSlot = id;
+}
+
+void ProcessList_GetSnapshot(const ProcessList *list, const ProcessData *process, ProcessSnapshot *outSnapshot)
+{
+    u32 id = ProcessList_GetSlotIndex(list, process);
+    outSnapshot->data = *process;
+    outSnapshot->cold = list->cold[id];
+    outSnapshot->handle = list->handles[id];
+    outSnapshot->pid = list->pids[id];
+    outSnapshot->flags = list->slots[id].flags;
+}
+
+// The heap only goes through the cold data: each entry is a pool index
+static inline u64 getHeapDeadline(const ProcessList *list, u32 slot)
+{
+    return list->cold[list->deadlineHeap[slot]].terminationDeadline;
+}
+
+static inline void setHeapSlot(ProcessList *list, u32 slot, u16 id)
+{
+    list->deadlineHeap[slot] = id;
+    list->cold[id].deadlineHeapSlot = (u16)slot;
+}
+
+static void siftUp(ProcessList *list, u32 slot)
+{
+    u16 id = list->deadlineHeap[slot];
+    u64 deadline = list->cold[id].terminationDeadline;
+    while (slot > 0) {
+        u32 parent = (slot - 1) >> 1;
+        if (getHeapDeadline(list, parent) <= deadline) {
+            break;
+        }
+
+        setHeapSlot(list, slot, list->deadlineHeap[parent]);
+        slot = parent;
+    }
+
+    setHeapSlot(list, slot, id);
+}
+
+static void siftDown(ProcessList *list, u32 slot)
+{
+    u16 id = list->deadlineHeap[slot];
+    u64 deadline = list->cold[id].terminationDeadline;
+    for (;;) {
+        u32 child = 2 * slot + 1;
+        if (child >= list->deadlineHeapSize) {
+            break;
+        }
+
+        if (child + 1 < list->deadlineHeapSize && getHeapDeadline(list, child + 1) < getHeapDeadline(list, child)) {
+            child++;
+        }
+
+        if (deadline <= getHeapDeadline(list, child)) {
+            break;
+        }
+
+        setHeapSlot(list, slot, list->deadlineHeap[child]);
+        slot = child;
+    }
+
+    setHeapSlot(list, slot, id);
+}
+
+void ProcessList_SetTerminationDeadline(ProcessList *list, ProcessData *process, u64 deadline)
+{
+    u16 id = (u16)ProcessList_GetSlotIndex(list, process);
+    ProcessColdData *cold = &list->cold[id];
+    if (cold->deadlineHeapSlot == PROCESSINDEX_EMPTY) {
+        cold->terminationDeadline = deadline;
+        setHeapSlot(list, list->deadlineHeapSize++, id);
+        siftUp(list, cold->deadlineHeapSlot);
+    } else {
+        u64 oldDeadline = cold->terminationDeadline;
+        cold->terminationDeadline = deadline;
+        if (deadline < oldDeadline) {
+            siftUp(list, cold->deadlineHeapSlot);
+        } else {
+            siftDown(list, cold->deadlineHeapSlot);
+        }
+    }
+}
+
+void ProcessList_ClearTerminationDeadline(ProcessList *list, ProcessData *process)
+{
+    ProcessColdData *cold = ProcessList_GetColdData(list, process);
+    u32 slot = cold->deadlineHeapSlot;
+    if (slot == PROCESSINDEX_EMPTY) {
+        return;
+    }
+
+    cold->deadlineHeapSlot = PROCESSINDEX_EMPTY;
+    if (slot != --list->deadlineHeapSize) {
+        // Move the last entry into the hole, then restore the heap property in whichever direction is needed
+        setHeapSlot(list, slot, list->deadlineHeap[list->deadlineHeapSize]);
+        if (slot > 0 && getHeapDeadline(list, slot) < getHeapDeadline(list, (slot - 1) >> 1)) {
+            siftUp(list, slot);
+        } else {
+            siftDown(list, slot);
+        }
+    }
+}
+
+ProcessData *ProcessList_GetNearestTerminationDeadline(const ProcessList *list)
+{
+    return list->deadlineHeapSize > 0 ? &list->pool[list->deadlineHeap[0]] : NULL;
+}
+
+bool ProcessList_SetDependencies(ProcessList *list, ProcessData *process, const u64 *dependencies, u32 numDeps)
+{
+    u16 first = PROCESSINDEX_EMPTY;
+    DependencyChunk *chunk = NULL;
+    u32 i;
+
+    for (i = 0; i < numDeps; i++) {
+        if ((dependencies[i] >> 32) != DEPENDENCY_TID_HIGH) {
+            break;
+        }
+
+        if (chunk == NULL || chunk->count >= sizeof(chunk->titleIdLows) / sizeof(u32)) {
+            u16 id = list->freeDependencyChunk;
+            if (id == PROCESSINDEX_EMPTY) {
+                break;
+            }
+
+            list->freeDependencyChunk = list->dependencyChunks[id].next;
+            list->dependencyChunks[id].next = PROCESSINDEX_EMPTY;
+            list->dependencyChunks[id].count = 0;
+            if (chunk == NULL) {
+                first = id;
+            } else {
+                chunk->next = id;
+            }
+            chunk = &list->dependencyChunks[id];
+        }
+
+        chunk->titleIdLows[chunk->count++] = (u32)dependencies[i];
+    }
+
+    process->dependencyChunk = first;
+    ProcessList_AddFlags(list, process, PROCESSFLAG_DEPENDENCIES_CACHED);
+
+    if (i < numDeps) {
+        // Couldn't store everything: out of chunks or unexpected titleId, let callers ask the loader
+        ProcessList_FreeDependencies(list, process);
+        return false;
+    }
+
+    return true;
+}
+
+static bool getDependencies(const ProcessList *list, u8 flags, u16 firstChunk, u64 *dependencies, u32 *numDeps)
+{
+    u32 num = 0;
+
+    if (!(flags & PROCESSFLAG_DEPENDENCIES_CACHED)) {
+        return false;
+    }
+
+    for (u16 id = firstChunk; id != PROCESSINDEX_EMPTY; id = list->dependencyChunks[id].next) {
+        const DependencyChunk *chunk = &list->dependencyChunks[id];
+        for (u32 i = 0; i < chunk->count; i++) {
+            dependencies[num++] = (DEPENDENCY_TID_HIGH << 32) | chunk->titleIdLows[i];
+        }
+    }
+
+    *numDeps = num;
+    return true;
+}
+
+static void freeDependencies(ProcessList *list, u8 *flags, u16 *firstChunk)
+{
+    if (*flags & PROCESSFLAG_DEPENDENCIES_CACHED) {
+        u16 id = *firstChunk;
+        while (id != PROCESSINDEX_EMPTY) {
+            u16 next = list->dependencyChunks[id].next;
+            list->dependencyChunks[id].next = list->freeDependencyChunk;
+            list->freeDependencyChunk = id;
+            id = next;
+        }
+
+        *firstChunk = PROCESSINDEX_EMPTY;
+        *flags &= ~PROCESSFLAG_DEPENDENCIES_CACHED;
+    }
+}
+
+bool ProcessList_GetDependencies(const ProcessList *list, const ProcessData *process, u64 *dependencies, u32 *numDeps)
+{
+    return getDependencies(list, ProcessList_GetFlags(list, process), process->dependencyChunk, dependencies, numDeps);
+}
+
+void ProcessList_FreeDependencies(ProcessList *list, ProcessData *process)
+{
+    freeDependencies(list, &list->slots[ProcessList_GetSlotIndex(list, process)].flags, &process->dependencyChunk);
+}
+
+bool ProcessList_GetSnapshotDependencies(const ProcessList *list, const ProcessSnapshot *snapshot, u64 *dependencies, u32 *numDeps)
+{
+    return getDependencies(list, snapshot->flags, snapshot->data.dependencyChunk, dependencies, numDeps);
+}
+
+void ProcessList_FreeSnapshotDependencies(ProcessList *list, ProcessSnapshot *snapshot)
+{
+    freeDependencies(list, &snapshot->flags, &snapshot->data.dependencyChunk);
 }
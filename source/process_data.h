@@ -2,10 +2,9 @@
 
 #include <3ds/types.h>
 #include <3ds/synchronization.h>
-#include "intrusive_list.h"
 
 #define FOREACH_PROCESS(list, process) \
-for (process = ProcessList_GetFirst(list); !ProcessList_TestEnd(list, process); process = ProcessList_GetNext(process))
+for (process = ProcessList_GetFirst(list); process != NULL; process = ProcessList_GetNext(list, process))
 
 enum {
     PROCESSFLAG_NOTIFY_TERMINATION              = BIT(0),
@@ -14,6 +13,8 @@ enum {
     PROCESSFLAG_AUTOLOADED                      = BIT(3),
     PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED   = BIT(4),
     PROCESSFLAG_NORMAL_APPLICATION              = BIT(5), // Official PM doesn't have this
+    PROCESSFLAG_DEPENDENCIES_CACHED             = BIT(6), // Ditto. Dependency list captured at launch
+    PROCESSFLAG_IDLE                            = BIT(7), // Ditto. Unused autoloaded process kept alive by the idle pool
 };
 
 typedef enum TerminationStatus {
@@ -23,73 +24,304 @@ typedef enum TerminationStatus {
     TERMSTATUS_TERMINATED           = 3,
 } TerminationStatus;
 
+// The part of a process slot that list scans go through, kept apart from ProcessData so that they touch few cache lines
+typedef struct ProcessSlot {
+    u16 next;           // list order (or next free slot), PROCESSINDEX_EMPTY at the end
+    u16 prev;
+    u16 generation;     // incremented each time the slot is freed, see ProcessRef
+    u8 terminationStatus;
+    u8 flags;
+} ProcessSlot;
+
+// Reference to a process that stays safe to hold across an unlock: resolving it fails once the process is deleted
+typedef struct ProcessRef {
+    u16 slot;
+    u16 generation;
+} ProcessRef;
+
+// The handle, pid and flags are in the list's dense per-slot arrays, see the accessors below
 typedef struct ProcessData {
-    IntrusiveNode node;
-    Handle handle;
-    u32 pid;
     u64 titleId;
     u64 programHandle;
-    u8 flags;
     u8 terminatedNotificationVariation;
-    TerminationStatus terminationStatus;
     u8 refcount;
+    u8 monitorShard;
+    u8 reslimitCategory; // from the exheader, RESLIMIT_CATEGORY_OTHER for KIPs
+    u16 nextSameTitleId; // next process sharing the same (masked) titleId, in list order (KIPs)
+    u16 dependencyChunk; // first chunk of the cached dependency list
 } ProcessData;
 
+// Only used while a process is being terminated, and for its termination trace. Parallel to pool
+typedef struct ProcessColdData {
+    u64 terminationDeadline;        // in ticks, force-terminated past it (see commitPendingTerminations)
+    u64 terminationNotifiedTick;    // 0 if never sent notification 0x100
+    u64 exitTick;                   // when the monitor saw the process exit
+    u16 deadlineHeapSlot;   // position in the termination deadline heap, PROCESSINDEX_EMPTY if not in it
+    u8 shutdownWave;        // scratch for terminateAllProcesses
+    u8 batchEntry;          // 1-based TerminateBatch entry that matched this process, 0 if none
+    bool forceTerminated;   // past its termination deadline, so its exit latency isn't learned (see exit_stats.h)
+    bool adaptiveDeadline;  // the termination deadline comes from exit_stats rather than from the caller
+} ProcessColdData;
+
+// Everything about a process, copied out of the list. The process monitor keeps one per exited process, whose slot
+// may be reused before its cleanup is done
+typedef struct ProcessSnapshot {
+    ProcessData data;
+    ProcessColdData cold;
+    Handle handle;
+    u32 pid;
+    u8 flags;
+} ProcessSnapshot;
+
+// Cached dependency lists only store the low u32 of the titleIds: they're all N3DS-masked sysmodules (0x00040130)
+#define DEPENDENCY_TID_HIGH             0x00040130ULL
+
+typedef struct DependencyChunk {
+    u16 next;
+    u16 count;
+    u32 titleIdLows[15];
+} DependencyChunk;
+
+// Lookup indexes maintained alongside the list (open addressing, linear probing, slot = pool index)
+enum {
+    PROCESSINDEX_PID = 0,
+    PROCESSINDEX_HANDLE,
+    PROCESSINDEX_TITLEID,
+
+    PROCESSINDEX_COUNT,
+};
+
+#define PROCESSINDEX_EMPTY              0xFFFF
+
+// One dependency chunk per process on average (a sysmodule rarely needs one, an application needs a few).
+// Index tables have a power-of-two size of at least 2*num entries, which is always less than 4*num.
+// The termination deadline heap has num entries
+#define PROCESSLIST_BUFFER_SIZE(num)    ((num) * (sizeof(ProcessData) + sizeof(ProcessColdData) + sizeof(ProcessSlot) + sizeof(u64) + 2 * sizeof(u32) +\
+                                        sizeof(DependencyChunk) + (PROCESSINDEX_COUNT * 4 + 1) * sizeof(u16)))
+
+#ifdef LOCK_PROFILING
+// One per ProcessList_Lock/ProcessList_LockShared call site (see below), linked in the first time it's used
+typedef struct ProcessListLockSite {
+    const char *file;
+    u32 line;
+    u32 numAcquires;
+    u32 numShared;
+    u32 numContended;   ///< had to wait for another thread
+    u32 maxDepth;       ///< writer recursion depth reached by this acquisition (shared ones count within an exclusive hold)
+    u32 maxConcurrentReaders; ///< readers holding the lock once this shared acquisition got it, itself included
+    u32 maxWaitTicks;
+    u32 maxHoldTicks;   ///< outermost exclusive acquisitions
+    u32 maxSharedHoldTicks; ///< shared acquisitions outside of an exclusive hold
+    u64 totalWaitTicks;
+    u64 totalHoldTicks;
+    u64 totalSharedHoldTicks;
+    struct ProcessListLockSite *next;
+} ProcessListLockSite;
+
+typedef struct ProcessListLockProfile {
+    char file[24];      ///< basename, truncated
+    u32 line;
+    u32 numAcquires;
+    u32 numShared;
+    u32 numContended;
+    u32 maxDepth;
+    u32 maxConcurrentReaders;
+    u32 maxWaitTicks;
+    u32 maxHoldTicks;
+    u32 maxSharedHoldTicks;
+    u64 totalWaitTicks;
+    u64 totalHoldTicks;
+    u64 totalSharedHoldTicks;
+} ProcessListLockProfile;
+
+// Readers whose hold time can be measured at the same time, the others aren't counted
+#define PROCESSLIST_PROFILED_READERS    8
+
+typedef struct ProcessListReaderHold {
+    u32 tag; ///< 0: unused
+    ProcessListLockSite *site;
+    u64 startTick;
+} ProcessListReaderHold;
+#endif
+
+// Reader/writer lock, recursive for the writer. The writer may also take it shared (which then nests in its exclusive
+// hold), but a reader must never take it again, shared or exclusively: new readers queue behind a waiting writer, so
+// either would wait for itself.
+typedef struct ProcessListLock {
+    LightLock lock; // protects the fields below
+    CondVar released;
+    u32 writerTag;
+    u32 writerDepth;
+    u32 numReaders;
+    u32 numWaitingWriters;
+#ifdef LOCK_PROFILING
+    ProcessListLockSite *sites;
+    ProcessListLockSite *holdSite;
+    u64 holdStartTick;
+    ProcessListReaderHold readerHolds[PROCESSLIST_PROFILED_READERS];
+#endif
+} ProcessListLock;
+
 typedef struct ProcessList {
-    RecursiveLock lock;
-    IntrusiveList list;
-    IntrusiveList freeList;
+    ProcessListLock lock;
+    ProcessData *pool;
+    ProcessColdData *cold; // parallel to pool, like the arrays below
+    ProcessSlot *slots;
+    u64 *titleIdKeys;   // masked titleIds, what the titleId index compares
+    Handle *handles;
+    u32 *pids;
+    u16 first;
+    u16 last;
+    u16 freeSlot;
+    DependencyChunk *dependencyChunks;
+    u16 freeDependencyChunk;
+    u16 *indexes[PROCESSINDEX_COUNT];
+    u32 indexBits;
+    u16 *deadlineHeap; // binary min-heap of pool indexes, keyed on terminationDeadline
+    u32 deadlineHeapSize;
 } ProcessList;
 
-static inline void ProcessList_Init(ProcessList *list, void *buf, size_t num)
+// ProcessList_LockShared is for lookups that don't modify anything (process data, indexes, g_manager fields) and
+// don't call anything that may. With LOCK_PROFILING, both lock functions record statistics per call site.
+#ifdef LOCK_PROFILING
+void ProcessList_LockProfiled(ProcessList *list, ProcessListLockSite *site);
+void ProcessList_LockSharedProfiled(ProcessList *list, ProcessListLockSite *site);
+u32 ProcessList_GetLockProfile(ProcessList *list, ProcessListLockProfile *outProfiles, u32 maxProfiles);
+
+#define PROCESSLIST_LOCK_AT_SITE(fn, list) do {\
+    static ProcessListLockSite site_ = { .file = __FILE__, .line = __LINE__ };\
+    fn(list, &site_);\
+} while (0)
+
+#define ProcessList_Lock(list)          PROCESSLIST_LOCK_AT_SITE(ProcessList_LockProfiled, list)
+#define ProcessList_LockShared(list)    PROCESSLIST_LOCK_AT_SITE(ProcessList_LockSharedProfiled, list)
+#else
+void ProcessList_Lock(ProcessList *list);
+void ProcessList_LockShared(ProcessList *list);
+#endif
+
+void ProcessList_Unlock(ProcessList *list);
+void ProcessList_UnlockShared(ProcessList *list);
+
+static inline u32 ProcessList_GetSlotIndex(const ProcessList *list, const ProcessData *process)
 {
-    IntrusiveList_Init(&list->list);
-    IntrusiveList_CreateFromBuffer(&list->freeList, buf, sizeof(ProcessData), sizeof(ProcessData) * num);
-    RecursiveLock_Init(&list->lock);
+    return process - list->pool;
 }
 
-static inline void ProcessList_Lock(ProcessList *list)
+static inline ProcessData *ProcessList_GetProcessAt(const ProcessList *list, u16 id)
 {
-    RecursiveLock_Lock(&list->lock);
+    return id != PROCESSINDEX_EMPTY ? &list->pool[id] : NULL;
 }
 
-static inline void ProcessList_Unlock(ProcessList *list)
+static inline ProcessData *ProcessList_GetFirst(const ProcessList *list)
 {
-    RecursiveLock_Unlock(&list->lock);
+    return ProcessList_GetProcessAt(list, list->first);
 }
 
-static inline ProcessData *ProcessList_GetNext(const ProcessData *process)
+static inline ProcessData *ProcessList_GetLast(const ProcessList *list)
 {
-    return (ProcessData *)process->node.next;
+    return ProcessList_GetProcessAt(list, list->last);
 }
 
-static inline ProcessData *ProcessList_GetPrev(const ProcessData *process)
+static inline ProcessData *ProcessList_GetNext(const ProcessList *list, const ProcessData *process)
 {
-    return (ProcessData *)process->node.next;
+    return ProcessList_GetProcessAt(list, list->slots[ProcessList_GetSlotIndex(list, process)].next);
 }
 
-static inline ProcessData *ProcessList_GetFirst(const ProcessList *list)
+static inline ProcessData *ProcessList_GetPrev(const ProcessList *list, const ProcessData *process)
 {
-    return (ProcessData *)list->list.first;
+    return ProcessList_GetProcessAt(list, list->slots[ProcessList_GetSlotIndex(list, process)].prev);
 }
 
-static inline ProcessData *ProcessList_GetLast(const ProcessList *list)
+static inline TerminationStatus ProcessList_GetTerminationStatus(const ProcessList *list, const ProcessData *process)
 {
-    return (ProcessData *)list->list.last;
+    return (TerminationStatus)list->slots[ProcessList_GetSlotIndex(list, process)].terminationStatus;
 }
 
-static inline bool ProcessList_TestEnd(const ProcessList *list, const ProcessData *process)
+static inline void ProcessList_SetTerminationStatus(ProcessList *list, ProcessData *process, TerminationStatus status)
 {
-    return IntrusiveList_TestEnd(&list->list, &process->node);
+    list->slots[ProcessList_GetSlotIndex(list, process)].terminationStatus = (u8)status;
 }
 
-ProcessData *ProcessList_New(ProcessList *list);
+static inline Handle ProcessList_GetHandle(const ProcessList *list, const ProcessData *process)
+{
+    return list->handles[ProcessList_GetSlotIndex(list, process)];
+}
+
+static inline u32 ProcessList_GetPid(const ProcessList *list, const ProcessData *process)
+{
+    return list->pids[ProcessList_GetSlotIndex(list, process)];
+}
+
+static inline u8 ProcessList_GetFlags(const ProcessList *list, const ProcessData *process)
+{
+    return list->slots[ProcessList_GetSlotIndex(list, process)].flags;
+}
+
+static inline void ProcessList_SetFlags(ProcessList *list, ProcessData *process, u8 flags)
+{
+    list->slots[ProcessList_GetSlotIndex(list, process)].flags = flags;
+}
+
+static inline void ProcessList_AddFlags(ProcessList *list, ProcessData *process, u8 flags)
+{
+    list->slots[ProcessList_GetSlotIndex(list, process)].flags |= flags;
+}
+
+static inline void ProcessList_RemoveFlags(ProcessList *list, ProcessData *process, u8 flags)
+{
+    list->slots[ProcessList_GetSlotIndex(list, process)].flags &= ~flags;
+}
+
+static inline ProcessColdData *ProcessList_GetColdData(const ProcessList *list, const ProcessData *process)
+{
+    return &list->cold[ProcessList_GetSlotIndex(list, process)];
+}
+
+static inline ProcessRef ProcessList_GetRef(const ProcessList *list, const ProcessData *process)
+{
+    u32 id = ProcessList_GetSlotIndex(list, process);
+    return (ProcessRef){ (u16)id, list->slots[id].generation };
+}
+
+/// Returns NULL if the process has been deleted since the reference was taken. Needs the list lock.
+static inline ProcessData *ProcessList_ResolveRef(const ProcessList *list, ProcessRef ref)
+{
+    return list->slots[ref.slot].generation == ref.generation ? &list->pool[ref.slot] : NULL;
+}
+
+void ProcessList_Init(ProcessList *list, void *buf, size_t num); // buf must be PROCESSLIST_BUFFER_SIZE(num) bytes
+
+ProcessData *ProcessList_New(ProcessList *list, Handle handle, u32 pid, u64 titleId);
 void ProcessList_Delete(ProcessList *list, ProcessData *process);
+void ProcessList_GetSnapshot(const ProcessList *list, const ProcessData *process, ProcessSnapshot *outSnapshot);
+
+bool ProcessList_SetDependencies(ProcessList *list, ProcessData *process, const u64 *dependencies, u32 numDeps);
+bool ProcessList_GetDependencies(const ProcessList *list, const ProcessData *process, u64 *dependencies, u32 *numDeps);
+void ProcessList_FreeDependencies(ProcessList *list, ProcessData *process);
+// Same, for the dependency list a snapshot has taken over (see the process monitor)
+bool ProcessList_GetSnapshotDependencies(const ProcessList *list, const ProcessSnapshot *snapshot, u64 *dependencies, u32 *numDeps);
+void ProcessList_FreeSnapshotDependencies(ProcessList *list, ProcessSnapshot *snapshot);
+
+void ProcessList_SetTerminationDeadline(ProcessList *list, ProcessData *process, u64 deadline); // inserts or updates
+void ProcessList_ClearTerminationDeadline(ProcessList *list, ProcessData *process);
+ProcessData *ProcessList_GetNearestTerminationDeadline(const ProcessList *list); // NULL if there is none
 
 ProcessData *ProcessList_FindProcessById(const ProcessList *list, u32 pid);
 ProcessData *ProcessList_FindProcessByTitleId(const ProcessList *list, u64 titleId);
 ProcessData *ProcessList_FindProcessByHandle(const ProcessList *list, Handle handle);
 
-void ProcessData_Incref(ProcessData *process, u32 amount);
-Result ProcessData_Notify(const ProcessData *process, u32 notificationId);
-Result ProcessData_SendTerminationNotification(ProcessData *process);
+void ProcessList_Incref(ProcessList *list, ProcessData *process, u32 amount);
+Result ProcessList_Notify(const ProcessList *list, const ProcessData *process, u32 notificationId);
+Result ProcessList_SendTerminationNotification(ProcessList *list, ProcessData *process);
+
+/// Termination notification to be sent once the list lock has been released (it's a srv IPC)
+typedef struct PendingTermination {
+    ProcessRef ref;
+    Handle handle; ///< duplicate, stays valid if the process is reaped in the meantime
+} PendingTermination;
+
+/// Needs the list lock. The process is marked as notified right away, so that nothing else notifies it again.
+void ProcessList_PrepareTerminationNotification(ProcessList *list, ProcessData *process, PendingTermination *outPending);
+/// Must be called without the list lock. Terminates the process if the notification couldn't be sent.
+Result ProcessList_SendPendingTerminationNotifications(ProcessList *list, const PendingTermination *pending, u32 numPending);
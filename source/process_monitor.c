@@ -1,111 +1,440 @@
 #include <3ds.h>
 #include <string.h>
 #include "process_monitor.h"
-#include "exheader_info_heap.h"
 #include "termination.h"
 #include "reslimit.h"
 #include "manager.h"
+#include "idle_pool.h"
+#include "launch_reservations.h"
+#include "exit_stats.h"
+#include "termination_trace.h"
+#include "my_thread.h"
 #include "util.h"
 
-static void cleanupProcess(ProcessData *process)
+#define MAX_PENDING_CHANGES     0x20
+#define MAX_HANDLES_PER_SHARD   63 // svcWaitSynchronizationN waits on 64 handles at most, one of them is the shard's event
+
+// cleanupProcess issues the fs:reg and loader unregistrations on these, while it does the sm one itself
+enum {
+    UNREGISTERHELPER_FSREG = 0,
+    UNREGISTERHELPER_LOADER,
+
+    UNREGISTERHELPER_COUNT,
+};
+
+typedef struct WaitList {
+    Handle handles[1 + MAX_HANDLES_PER_SHARD];          ///< [0] is the shard's change event
+    ProcessData *processes[1 + MAX_HANDLES_PER_SHARD];  ///< Parallel to handles
+    u32 count;
+} WaitList;
+
+typedef struct ProcessMonitorShard {
+    MyThread thread;
+    Handle changeEvent;
+    u8 id;
+    bool started;
+    bool needsRebuild;
+    u32 numAssigned;
+    u32 numPendingChanges;
+    struct {
+        ProcessData *process;
+        bool added;
+    } pendingChanges[MAX_PENDING_CHANGES];
+    WaitList waitList; // only accessed by the shard thread
+} ProcessMonitorShard;
+
+static struct {
+    ProcessMonitorShard *shards;
+    u8 *shardStacks;
+    u32 numShards;
+
+    // Ring buffer of the snapshots of exited processes, protected by the process list lock
+    ProcessSnapshot *exits;
+    u32 exitsCapacity;
+    u32 exitsHead;
+    u32 numExits;
+    LightSemaphore exitSlots;
+    LightEvent exitEvent;
+
+    struct {
+        MyThread thread;
+        LightEvent start;
+    } unregisterHelpers[UNREGISTERHELPER_COUNT];
+    LightSemaphore unregisterDone;
+    u32 unregisterPid;
+    u64 unregisterProgramHandle;
+
+    ProcessMonitorStats stats; // protected by the process list lock
+} g_processMonitor;
+
+static void processMonitorShard(void *p);
+static void unregisterHelper(void *p);
+
+static inline size_t getNumShards(size_t numProc)
+{
+    return (numProc + MAX_HANDLES_PER_SHARD - 1) / MAX_HANDLES_PER_SHARD;
+}
+
+size_t ProcessMonitor_GetBufferSize(size_t numProc)
+{
+    size_t numShards = getNumShards(numProc);
+    return (numShards + UNREGISTERHELPER_COUNT) * THREAD_STACK_SIZE + numShards * sizeof(ProcessMonitorShard) + numProc * sizeof(ProcessSnapshot);
+}
+
+size_t ProcessMonitor_GetNumThreads(size_t numProc)
+{
+    return getNumShards(numProc) + UNREGISTERHELPER_COUNT;
+}
+
+void ProcessMonitor_Init(void *buf, size_t numProc)
+{
+    size_t numShards = getNumShards(numProc);
+
+    memset(&g_processMonitor, 0, sizeof(g_processMonitor));
+    g_processMonitor.shardStacks = (u8 *)buf;
+    u8 *helperStacks = g_processMonitor.shardStacks + numShards * THREAD_STACK_SIZE;
+    g_processMonitor.shards = (ProcessMonitorShard *)(helperStacks + UNREGISTERHELPER_COUNT * THREAD_STACK_SIZE);
+    g_processMonitor.numShards = numShards;
+    g_processMonitor.exits = (ProcessSnapshot *)(g_processMonitor.shards + numShards);
+    g_processMonitor.exitsCapacity = numProc;
+
+    memset(g_processMonitor.shards, 0, numShards * sizeof(ProcessMonitorShard));
+    for (u32 i = 0; i < numShards; i++) {
+        g_processMonitor.shards[i].id = (u8)i;
+    }
+
+    LightSemaphore_Init(&g_processMonitor.exitSlots, (s16)numProc, (s16)numProc);
+    LightEvent_Init(&g_processMonitor.exitEvent, RESET_ONESHOT);
+
+    LightSemaphore_Init(&g_processMonitor.unregisterDone, 0, UNREGISTERHELPER_COUNT);
+    for (u32 i = 0; i < UNREGISTERHELPER_COUNT; i++) {
+        LightEvent_Init(&g_processMonitor.unregisterHelpers[i].start, RESET_ONESHOT);
+        assertSuccess(MyThread_Create(&g_processMonitor.unregisterHelpers[i].thread, unregisterHelper, (void *)i, helperStacks + i * THREAD_STACK_SIZE, THREAD_STACK_SIZE, 0x17, -2));
+    }
+}
+
+static void startShard(ProcessMonitorShard *shard)
+{
+    // Shards are started lazily, most setups only ever need one
+    assertSuccess(svcCreateEvent(&shard->changeEvent, RESET_ONESHOT));
+    shard->waitList.handles[0] = shard->changeEvent;
+    shard->waitList.count = 1;
+    shard->started = true;
+
+    u8 *stack = g_processMonitor.shardStacks + shard->id * THREAD_STACK_SIZE;
+    assertSuccess(MyThread_Create(&shard->thread, processMonitorShard, shard, stack, THREAD_STACK_SIZE, 0x17, -2));
+}
+
+static void pushChange(ProcessMonitorShard *shard, ProcessData *process, bool added)
+{
+    if (shard->numPendingChanges >= MAX_PENDING_CHANGES) {
+        shard->needsRebuild = true;
+    } else if (!shard->needsRebuild) {
+        shard->pendingChanges[shard->numPendingChanges].process = process;
+        shard->pendingChanges[shard->numPendingChanges++].added = added;
+    }
+
+    assertSuccess(svcSignalEvent(shard->changeEvent));
+}
+
+bool ProcessMonitor_AddProcess(ProcessData *process)
+{
+    u32 i;
+    for (i = 0; i < g_processMonitor.numShards && g_processMonitor.shards[i].numAssigned >= MAX_HANDLES_PER_SHARD; i++);
+    if (i >= g_processMonitor.numShards) {
+        return false;
+    }
+
+    ProcessMonitorShard *shard = &g_processMonitor.shards[i];
+    if (!shard->started) {
+        startShard(shard);
+    }
+
+    process->monitorShard = shard->id;
+    ++shard->numAssigned;
+    pushChange(shard, process, true);
+    return true;
+}
+
+void ProcessMonitor_RemoveProcess(ProcessData *process)
+{
+    ProcessMonitorShard *shard = &g_processMonitor.shards[process->monitorShard];
+    --shard->numAssigned;
+    pushChange(shard, process, false);
+}
+
+void ProcessMonitor_Wake(void)
 {
-    if (process->flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
-        ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
+    LightEvent_Signal(&g_processMonitor.exitEvent);
+}
+
+void ProcessMonitor_GetStats(ProcessMonitorStats *outStats)
+{
+    ProcessList_LockShared(&g_manager.processList);
+    *outStats = g_processMonitor.stats;
+    ProcessList_UnlockShared(&g_manager.processList);
+}
+
+static void removeWaitListEntry(WaitList *waitList, u32 id)
+{
+    --waitList->count;
+    waitList->handles[id] = waitList->handles[waitList->count];
+    waitList->processes[id] = waitList->processes[waitList->count];
+}
+
+// Returns true if entries have been moved around. Needs the list lock.
+static bool applyPendingChanges(ProcessMonitorShard *shard)
+{
+    WaitList *waitList = &shard->waitList;
+    bool moved = false;
+
+    if (shard->needsRebuild) {
+        ProcessData *process;
 
-        if (exheaderInfo == NULL) {
-            panic(0);
+        waitList->count = 1;
+        FOREACH_PROCESS(&g_manager.processList, process) {
+            if (ProcessList_GetTerminationStatus(&g_manager.processList, process) != TERMSTATUS_TERMINATED && process->monitorShard == shard->id) {
+                waitList->handles[waitList->count] = ProcessList_GetHandle(&g_manager.processList, process);
+                waitList->processes[waitList->count++] = process;
+            }
         }
 
-        listAndTerminateDependencies(process, exheaderInfo);
+        shard->needsRebuild = false;
+        shard->numPendingChanges = 0;
+        return true;
+    }
 
-        ExHeaderInfoHeap_Delete(exheaderInfo);
+    for (u32 i = 0; i < shard->numPendingChanges; i++) {
+        ProcessData *process = shard->pendingChanges[i].process;
+        if (shard->pendingChanges[i].added) {
+            waitList->handles[waitList->count] = ProcessList_GetHandle(&g_manager.processList, process);
+            waitList->processes[waitList->count++] = process;
+        } else {
+            u32 id;
+            for (id = 1; id < waitList->count && waitList->processes[id] != process; id++);
+            if (id < waitList->count) {
+                removeWaitListEntry(waitList, id);
+                moved = true;
+            }
+        }
     }
 
-    if (!(process->flags & PROCESSFLAG_KIP)) {
-        SRVPM_UnregisterProcess(process->pid);
-        FSREG_Unregister(process->pid);
-        LOADER_UnregisterProgram(process->programHandle);
+    shard->numPendingChanges = 0;
+    return moved;
+}
+
+static void unregisterHelper(void *p)
+{
+    u32 role = (u32)p;
+
+    for (;;) {
+        LightEvent_Wait(&g_processMonitor.unregisterHelpers[role].start);
+        if (role == UNREGISTERHELPER_FSREG) {
+            FSREG_Unregister(g_processMonitor.unregisterPid);
+        } else {
+            LOADER_UnregisterProgram(g_processMonitor.unregisterProgramHandle);
+        }
+        LightSemaphore_Release(&g_processMonitor.unregisterDone, 1);
+    }
+}
+
+static void cleanupProcess(const ProcessSnapshot *snapshot)
+{
+    if (snapshot->flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
+        listAndTerminateDependencies(snapshot);
+    }
+
+    if (!(snapshot->flags & PROCESSFLAG_KIP)) {
+        // sm, fs:reg and loader are separate sessions, the three unregistrations don't depend on each other
+        g_processMonitor.unregisterPid = snapshot->pid;
+        g_processMonitor.unregisterProgramHandle = snapshot->data.programHandle;
+        for (u32 i = 0; i < UNREGISTERHELPER_COUNT; i++) {
+            LightEvent_Signal(&g_processMonitor.unregisterHelpers[i].start);
+        }
+
+        SRVPM_UnregisterProcess(snapshot->pid);
+        LightSemaphore_Acquire(&g_processMonitor.unregisterDone, UNREGISTERHELPER_COUNT);
     }
 
     ProcessList_Lock(&g_manager.processList);
-    if (g_manager.runningApplicationData != NULL && process->handle == g_manager.runningApplicationData->handle) {
+    if (g_manager.runningApplicationData != NULL && snapshot->handle == ProcessList_GetHandle(&g_manager.processList, g_manager.runningApplicationData)) {
         if (IS_N3DS && APPMEMTYPE == 6) {
             assertSuccess(resetAppMemLimit());
         }
         g_manager.runningApplicationData = NULL;
     }
 
-    if (g_manager.debugData != NULL && process->handle == g_manager.debugData->handle) {
+    if (g_manager.debugData != NULL && snapshot->handle == ProcessList_GetHandle(&g_manager.processList, g_manager.debugData)) {
         g_manager.debugData = NULL;
     }
     ProcessList_Unlock(&g_manager.processList);
 
-    if (process->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
-        notifySubscribers(0x110 + process->terminatedNotificationVariation);
+    if (snapshot->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
+        notifySubscribers(0x110 + snapshot->data.terminatedNotificationVariation);
     }
 }
 
-void processMonitor(void *p)
+// Needs the list lock, and an exit queue slot
+static void reapExit(ProcessMonitorShard *shard, s32 id)
 {
-    (void)p;
+    // Note: official PM conditionally erases the process from the list, cleans up, then conditionally frees the process data
+    // Bug in official PM (?): it unlocks the list before setting termstatus = TERMSTATUS_TERMINATED
+    WaitList *waitList = &shard->waitList;
+    ProcessData *process = waitList->processes[id];
+    removeWaitListEntry(waitList, id);
+    --shard->numAssigned;
 
-    Handle handles[0x41] = { g_manager.newProcessEvent };
+    ProcessColdData *cold = ProcessList_GetColdData(&g_manager.processList, process);
+    cold->exitTick = svcGetSystemTick();
+    if (ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_NOTIFICATION_SENT && !cold->forceTerminated) {
+        ExitStats_Record(process->titleId, cold->exitTick - cold->terminationNotifiedTick);
+    }
+
+    ProcessList_SetTerminationStatus(&g_manager.processList, process, TERMSTATUS_TERMINATED);
+    ProcessList_ClearTerminationDeadline(&g_manager.processList, process);
+    if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_IDLE) {
+        IdlePool_Remove(process);
+    }
+    if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NOTIFY_TERMINATION) {
+        ProcessList_AddFlags(&g_manager.processList, process, PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED);
+    }
+
+    // Make sure no list access is done through this copy
+    u32 tail = g_processMonitor.exitsHead + g_processMonitor.numExits++;
+    ProcessList_GetSnapshot(&g_manager.processList, process, &g_processMonitor.exits[tail >= g_processMonitor.exitsCapacity ? tail - g_processMonitor.exitsCapacity : tail]);
+
+    // Note: PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED can be set by terminateProcessImpl
+    // APT is shit, why must an app call APT to ask to terminate itself?
+
+    if (!(ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED)) {
+        // The cached dependency list now belongs to the copy, it is freed after cleanup
+        ProcessList_RemoveFlags(&g_manager.processList, process, PROCESSFLAG_DEPENDENCIES_CACHED);
+        ProcessList_Delete(&g_manager.processList, process);
+    }
+}
+
+static void processMonitorShard(void *p)
+{
+    ProcessMonitorShard *shard = (ProcessMonitorShard *)p;
+    WaitList *waitList = &shard->waitList;
+    s32 id = -1;
 
     for (;;) {
-        u32 numProcesses = 0;
-        bool atLeastOneTerminating = false;
-        ProcessData *process;
-        ProcessData processBackup;
-        s32 id = -1;
+        bool exited = false;
+
+        if (id > 0) {
+            // Make sure there is room in the exit queue before taking the lock
+            LightSemaphore_Acquire(&g_processMonitor.exitSlots, 1);
+        }
 
         ProcessList_Lock(&g_manager.processList);
-        FOREACH_PROCESS(&g_manager.processList, process) {
-            // Rebuild the handle array
-            if (process->terminationStatus != TERMSTATUS_TERMINATED) {
-                handles[1 + numProcesses++] = process->handle;
-                if (process->terminationStatus == TERMSTATUS_NOTIFICATION_SENT) {
-                    atLeastOneTerminating = true;
+        if (applyPendingChanges(shard) && id > 0) {
+            // Entries have moved, the signalled handle (if any) will be reported again by the next wait
+            LightSemaphore_Release(&g_processMonitor.exitSlots, 1);
+            id = -1;
+        }
+
+        if (id > 0) {
+            u32 numReaped = 1;
+            reapExit(shard, id);
+
+            // When several processes exit together (reboot, application and its dependencies), reap all those that
+            // are already signalled now rather than going through a full iteration for each of them
+            while (waitList->count > 1 && LightSemaphore_TryAcquire(&g_processMonitor.exitSlots, 1) == 0) {
+                s32 other = -1;
+                if (svcWaitSynchronizationN(&other, waitList->handles + 1, waitList->count - 1, false, 0LL) != 0 || other < 0) {
+                    LightSemaphore_Release(&g_processMonitor.exitSlots, 1);
+                    break;
                 }
+
+                reapExit(shard, 1 + other);
+                ++numReaped;
             }
+
+            ProcessMonitorStats *stats = &g_processMonitor.stats;
+            ++stats->numWakeups;
+            stats->numReaped += numReaped;
+            stats->maxReapedPerWakeup = numReaped > stats->maxReapedPerWakeup ? numReaped : stats->maxReapedPerWakeup;
+            ++stats->reapedPerWakeupHistogram[numReaped >= PROCESSMONITOR_HISTOGRAM_SIZE ? PROCESSMONITOR_HISTOGRAM_SIZE - 1 : numReaped - 1];
+            exited = true;
         }
         ProcessList_Unlock(&g_manager.processList);
 
-        // If no more processes are terminating, signal the event
-        if (g_manager.waitingForTermination && !atLeastOneTerminating) {
-            assertSuccess(svcSignalEvent(g_manager.allNotifiedTerminationEvent));
+        if (exited) {
+            LightEvent_Signal(&g_processMonitor.exitEvent);
         }
 
         // Note: lack of assertSuccess is intentional.
-        svcWaitSynchronizationN(&id, handles, 1 + numProcesses, false, -1LL);
+        id = -1;
+        svcWaitSynchronizationN(&id, waitList->handles, waitList->count, false, -1LL);
+    }
+}
 
-        if (id > 0) {
-            // Note: official PM conditionally erases the process from the list, cleans up, then conditionally frees the process data
-            // Bug in official PM (?): it unlocks the list before setting termstatus = TERMSTATUS_TERMINATED
-            ProcessList_Lock(&g_manager.processList);
-            process = ProcessList_FindProcessByHandle(&g_manager.processList, handles[id]);
-            if (process != NULL) {
-                process->terminationStatus = TERMSTATUS_TERMINATED;
-                if (process->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
-                    process->flags |= PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED;
-                }
+void processMonitor(void *p)
+{
+    (void)p;
 
-                processBackup = *process; // <-- make sure no list access is done through this node
+    for (;;) {
+        // Also woken up to evict the idle processes whose grace period has expired (or all of them if memory is short),
+        // and to release expired launch reservations
+        s64 timeout = IdlePool_GetTimeout();
+        s64 reservationTimeout = LaunchReservations_GetTimeout();
+        timeout = timeout < 0 || (reservationTimeout >= 0 && reservationTimeout < timeout) ? reservationTimeout : timeout;
+        if (timeout < 0) {
+            LightEvent_Wait(&g_processMonitor.exitEvent);
+        } else {
+            LightEvent_WaitTimeout(&g_processMonitor.exitEvent, timeout);
+        }
 
-                // Note: PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED can be set by terminateProcessImpl
-                // APT is shit, why must an app call APT to ask to terminate itself?
+        for (;;) {
+            ProcessSnapshot processBackup;
+            bool exited = false;
 
-                if (!(process->flags & PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED)) {
-                    ProcessList_Delete(&g_manager.processList, process);
-                }
+            ProcessList_Lock(&g_manager.processList);
+            if (g_processMonitor.numExits > 0) {
+                processBackup = g_processMonitor.exits[g_processMonitor.exitsHead];
+                g_processMonitor.exitsHead = g_processMonitor.exitsHead + 1 >= g_processMonitor.exitsCapacity ? 0 : g_processMonitor.exitsHead + 1;
+                --g_processMonitor.numExits;
+                exited = true;
             }
             ProcessList_Unlock(&g_manager.processList);
 
-            if (process != NULL) {
-                cleanupProcess(&processBackup);
-                if (!(processBackup.flags & PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED)) {
-                    svcCloseHandle(processBackup.handle);
+            if (!exited) {
+                break;
+            }
+
+            LightSemaphore_Release(&g_processMonitor.exitSlots, 1);
+            cleanupProcess(&processBackup);
+            TerminationTrace_Record(&processBackup, svcGetSystemTick());
+            if (!(processBackup.flags & PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED)) {
+                ProcessList_Lock(&g_manager.processList);
+                ProcessList_FreeSnapshotDependencies(&g_manager.processList, &processBackup);
+                ProcessList_Unlock(&g_manager.processList);
+                svcCloseHandle(processBackup.handle);
+            }
+        }
+
+        IdlePool_EvictExpired();
+        IdlePool_EvictIfUnderMemoryPressure();
+        LaunchReservations_ReleaseExpired();
+
+        // If no more processes are terminating, signal the event
+        if (g_manager.waitingForTermination) {
+            bool atLeastOneTerminating = false;
+            ProcessData *process;
+
+            ProcessList_LockShared(&g_manager.processList);
+            FOREACH_PROCESS(&g_manager.processList, process) {
+                if (ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_NOTIFICATION_SENT) {
+                    atLeastOneTerminating = true;
+                    break;
                 }
             }
+            ProcessList_UnlockShared(&g_manager.processList);
+
+            if (!atLeastOneTerminating) {
+                assertSuccess(svcSignalEvent(g_manager.allNotifiedTerminationEvent));
+            }
         }
     }
 }
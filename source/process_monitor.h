@@ -1,3 +1,26 @@
 #pragma once
 
+#include "process_data.h"
+
+size_t ProcessMonitor_GetBufferSize(size_t numProc);
+size_t ProcessMonitor_GetNumThreads(size_t numProc); // the shard threads are started lazily, but may all be needed
+void ProcessMonitor_Init(void *buf, size_t numProc);
+
+// These need the process list lock to be held. Adding fails if all shards are full.
+bool ProcessMonitor_AddProcess(ProcessData *process);
+void ProcessMonitor_RemoveProcess(ProcessData *process);
+void ProcessMonitor_Wake(void); // makes the main process monitor thread re-check the idle pool and launch reservation deadlines
+
+#define PROCESSMONITOR_HISTOGRAM_SIZE 8
+
+typedef struct ProcessMonitorStats {
+    u32 numWakeups;         ///< shard wakeups that reaped at least one exit
+    u32 numReaped;
+    u32 maxReapedPerWakeup;
+    u32 reapedPerWakeupHistogram[PROCESSMONITOR_HISTOGRAM_SIZE]; ///< [i]: wakeups that reaped i+1 exits, the last one is open-ended
+} ProcessMonitorStats;
+
+void ProcessMonitor_GetStats(ProcessMonitorStats *outStats);
+
+/// Thread function, reaps the processes reported by the monitor shards
 void processMonitor(void *p);
@@ -25,10 +25,109 @@
 */
 
 #include <3ds.h>
+#include <string.h>
 #include "service_manager.h"
 
 #define TRY(expr) if(R_FAILED(res = (expr))) goto cleanup;
 
+typedef struct DeferredReply {
+    Handle session; ///< 0 if the slot is free
+    u32 generation;
+    bool completed;
+    u32 cmdbuf[0x40];
+} DeferredReply;
+
+static struct {
+    LightLock lock;
+    Handle completionEvent;
+    Handle currentSession;
+    bool currentCommandDeferred;
+    u32 generation;
+    DeferredReply replies[SERVICEMANAGER_MAX_DEFERRED_REPLIES];
+} g_deferredReplies;
+
+u32 ServiceManager_DeferReply(void)
+{
+    u32 token = 0;
+
+    LightLock_Lock(&g_deferredReplies.lock);
+    for (u32 i = 0; i < SERVICEMANAGER_MAX_DEFERRED_REPLIES; i++) {
+        DeferredReply *reply = &g_deferredReplies.replies[i];
+        if (reply->session == 0) {
+            g_deferredReplies.generation = (g_deferredReplies.generation + 1) & 0xFFFFFF;
+            g_deferredReplies.generation += g_deferredReplies.generation == 0 ? 1 : 0;
+
+            reply->session = g_deferredReplies.currentSession;
+            reply->generation = g_deferredReplies.generation;
+            reply->completed = false;
+            g_deferredReplies.currentCommandDeferred = true;
+            token = (reply->generation << 8) | i;
+            break;
+        }
+    }
+    LightLock_Unlock(&g_deferredReplies.lock);
+
+    return token;
+}
+
+void ServiceManager_CompleteReply(u32 token, const u32 *cmdbuf)
+{
+    u32 hdr = cmdbuf[0];
+    u32 size = 1 + ((hdr >> 6) & 0x3F) + (hdr & 0x3F);
+    DeferredReply *reply = &g_deferredReplies.replies[token & 0xFF];
+
+    LightLock_Lock(&g_deferredReplies.lock);
+    // The session may have been closed in the meantime
+    if (reply->session != 0 && reply->generation == token >> 8) {
+        memcpy(reply->cmdbuf, cmdbuf, 4 * (size > 0x40 ? 0x40 : size));
+        reply->completed = true;
+    }
+    LightLock_Unlock(&g_deferredReplies.lock);
+
+    svcSignalEvent(g_deferredReplies.completionEvent);
+}
+
+// Only one reply can be sent per svcReplyAndReceive call: if more are completed, signal the (oneshot) completion event
+// again so that the next one is picked up right after this one
+static Handle popCompletedReply(u32 *cmdbuf)
+{
+    Handle session = 0;
+    bool morePending = false;
+
+    LightLock_Lock(&g_deferredReplies.lock);
+    for (u32 i = 0; i < SERVICEMANAGER_MAX_DEFERRED_REPLIES; i++) {
+        DeferredReply *reply = &g_deferredReplies.replies[i];
+        if (reply->session != 0 && reply->completed) {
+            if (session != 0) {
+                morePending = true;
+                break;
+            }
+
+            memcpy(cmdbuf, reply->cmdbuf, sizeof(reply->cmdbuf));
+            session = reply->session;
+            reply->session = 0;
+        }
+    }
+    LightLock_Unlock(&g_deferredReplies.lock);
+
+    if (morePending) {
+        svcSignalEvent(g_deferredReplies.completionEvent);
+    }
+
+    return session;
+}
+
+static void dropDeferredReplies(Handle session)
+{
+    LightLock_Lock(&g_deferredReplies.lock);
+    for (u32 i = 0; i < SERVICEMANAGER_MAX_DEFERRED_REPLIES; i++) {
+        if (g_deferredReplies.replies[i].session == session) {
+            g_deferredReplies.replies[i].session = 0;
+        }
+    }
+    LightLock_Unlock(&g_deferredReplies.lock);
+}
+
 Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const ServiceManagerNotificationEntry *notifications, const ServiceManagerContextAllocator *allocator)
 {
     Result res = 0;
@@ -43,7 +142,9 @@ Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const Serv
         maxSessionsTotal += services[i].maxSessions;
     }
 
-    Handle waitHandles[1 + numServices + maxSessionsTotal];
+    // Layout: notification, ports, deferred reply completion event, sessions
+    u32 firstSession = 2 + numServices;
+    Handle waitHandles[firstSession + maxSessionsTotal];
     void *ctxs[maxSessionsTotal];
     u8 handlerIds[maxSessionsTotal];
 
@@ -53,6 +154,11 @@ Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const Serv
 
     TRY(srvEnableNotification(&waitHandles[0]));
 
+    memset(&g_deferredReplies, 0, sizeof(g_deferredReplies));
+    LightLock_Init(&g_deferredReplies.lock);
+    TRY(svcCreateEvent(&waitHandles[1 + numServices], RESET_ONESHOT));
+    g_deferredReplies.completionEvent = waitHandles[1 + numServices];
+
     // Subscribe to notifications if needed.
     for (u32 i = 0; notifications[i].handler != NULL; i++) {
         // Termination & ready for reboot events send by PM using PublishToProcess don't require subscription.
@@ -73,34 +179,39 @@ Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const Serv
 
     while (!terminationRequested) {
         if (replyTarget == 0) {
-            cmdbuf[0] = 0xFFFF0000;
+            // Send one of the deferred replies that have been completed, if any
+            replyTarget = popCompletedReply(cmdbuf);
+            if (replyTarget == 0) {
+                cmdbuf[0] = 0xFFFF0000;
+            }
         }
 
         id = -1;
-        res = svcReplyAndReceive(&id, waitHandles, 1 + numServices + numActiveSessions, replyTarget);
+        res = svcReplyAndReceive(&id, waitHandles, firstSession + numActiveSessions, replyTarget);
 
         if (res == (Result)0xC920181A) {
             // Session has been closed
             u32 off;
             if (id == -1) {
-                for (off = 0; off < numActiveSessions && waitHandles[1 + numServices + off] != replyTarget; off++);
+                for (off = 0; off < numActiveSessions && waitHandles[firstSession + off] != replyTarget; off++);
                 if (off >= numActiveSessions) {
                     return res;
                 }
 
-                id = 1 + numServices + off;
-            } else if ((u32)id < 1 + numServices) {
+                id = firstSession + off;
+            } else if ((u32)id < firstSession) {
                 return res;
             }
 
-            off = id - 1 - numServices;
+            off = id - firstSession;
 
             Handle h = waitHandles[id];
             void *ctx = ctxs[off];
-            waitHandles[id] = waitHandles[1 + numServices + --numActiveSessions];
+            waitHandles[id] = waitHandles[firstSession + --numActiveSessions];
             handlerIds[off] = handlerIds[numActiveSessions];
             ctxs[off] = ctxs[numActiveSessions];
 
+            dropDeferredReplies(h);
             svcCloseHandle(h);
             if (allocator != NULL) {
                 allocator->freeSessionContext(ctx);
@@ -141,20 +252,24 @@ Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const Serv
                     }
                 }
 
-                waitHandles[1 + numServices + numActiveSessions] = session;
+                waitHandles[firstSession + numActiveSessions] = session;
                 handlerIds[numActiveSessions] = (u8)(id - 1);
                 ctxs[numActiveSessions++] = ctx;
+            } else if ((u32)id == 1 + numServices) {
+                // Deferred replies have been completed, they're sent at the top of the loop
             } else {
                 // Service command
-                u32 off = id - 1 - numServices;
+                u32 off = id - firstSession;
+                g_deferredReplies.currentSession = waitHandles[id];
+                g_deferredReplies.currentCommandDeferred = false;
                 services[handlerIds[off]].handler(ctxs[off]);
-                replyTarget = waitHandles[id];
+                replyTarget = g_deferredReplies.currentCommandDeferred ? 0 : waitHandles[id];
             }
         }
     }
 
 cleanup:
-    for (u32 i = 0; i < 1 + numServices + numActiveSessions; i++) {
+    for (u32 i = 0; i < firstSession + numActiveSessions; i++) {
         svcCloseHandle(waitHandles[i]);
     }
 
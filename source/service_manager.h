@@ -20,3 +20,14 @@ typedef struct ServiceManagerContextAllocator {
 } ServiceManagerContextAllocator;
 
 Result ServiceManager_Run(const ServiceManagerServiceEntry *services, const ServiceManagerNotificationEntry *notifications, const ServiceManagerContextAllocator *allocator);
+
+#define SERVICEMANAGER_MAX_DEFERRED_REPLIES 8
+
+/**
+ * @brief Called by a command handler to reply later instead of when it returns. The session is parked, others keep being serviced.
+ * @return A token to pass to @ref ServiceManager_CompleteReply, or 0 if too many replies are already pending (reply normally then).
+ */
+u32 ServiceManager_DeferReply(void);
+
+/// Sends a deferred reply (from any thread). cmdbuf is copied, and the reply is sent by the service manager thread.
+void ServiceManager_CompleteReply(u32 token, const u32 *cmdbuf);
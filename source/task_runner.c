@@ -7,25 +7,67 @@ TaskRunner g_taskRunner;
 void TaskRunner_Init(void)
 {
     memset(&g_taskRunner, 0, sizeof(TaskRunner));
-    LightEvent_Init(&g_taskRunner.readyEvent, RESET_ONESHOT);
-    LightEvent_Init(&g_taskRunner.parametersSetEvent, RESET_ONESHOT);
+    LightLock_Init(&g_taskRunner.lock);
+    LightSemaphore_Init(&g_taskRunner.pendingTasks, 0, TASKRUNNER_MAX_TASKS);
 }
 
-void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
+Result TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
 {
-    argsize = argsize > sizeof(g_taskRunner.argStorage) ? sizeof(g_taskRunner.argStorage) : argsize;
-    LightEvent_Wait(&g_taskRunner.readyEvent);
-    g_taskRunner.task = task;
-    memcpy(g_taskRunner.argStorage, argdata, argsize);
-    LightEvent_Signal(&g_taskRunner.parametersSetEvent);
+    argsize = argsize > sizeof(g_taskRunner.tasks[0].argStorage) ? sizeof(g_taskRunner.tasks[0].argStorage) : argsize;
+
+    LightLock_Lock(&g_taskRunner.lock);
+    if (g_taskRunner.numQueued >= TASKRUNNER_MAX_TASKS) {
+        ++g_taskRunner.stats.numTasksRejected;
+        LightLock_Unlock(&g_taskRunner.lock);
+        return 0xC8605BF0;
+    }
+
+    u32 tail = g_taskRunner.head + g_taskRunner.numQueued++;
+    TaskRunnerTask *t = &g_taskRunner.tasks[tail % TASKRUNNER_MAX_TASKS];
+    t->task = task;
+    t->enqueuedTick = svcGetSystemTick();
+    memcpy(t->argStorage, argdata, argsize);
+
+    if (g_taskRunner.numQueued > g_taskRunner.stats.maxQueueDepth) {
+        g_taskRunner.stats.maxQueueDepth = g_taskRunner.numQueued;
+    }
+    LightLock_Unlock(&g_taskRunner.lock);
+
+    LightSemaphore_Release(&g_taskRunner.pendingTasks, 1);
+    return 0;
+}
+
+void TaskRunner_GetStats(TaskRunnerStats *outStats, u32 *outQueueDepth)
+{
+    LightLock_Lock(&g_taskRunner.lock);
+    *outStats = g_taskRunner.stats;
+    *outQueueDepth = g_taskRunner.numQueued;
+    LightLock_Unlock(&g_taskRunner.lock);
 }
 
 void TaskRunner_HandleTasks(void *p)
 {
     (void)p;
     for (;;) {
-        LightEvent_Signal(&g_taskRunner.readyEvent);
-        LightEvent_Wait(&g_taskRunner.parametersSetEvent);
-        g_taskRunner.task(g_taskRunner.argStorage);
+        LightSemaphore_Acquire(&g_taskRunner.pendingTasks, 1);
+
+        // Only this thread moves the head, and the head slot isn't reused before we're done with it
+        TaskRunnerTask *t = &g_taskRunner.tasks[g_taskRunner.head];
+        u64 waitTicks = svcGetSystemTick() - t->enqueuedTick;
+
+        LightLock_Lock(&g_taskRunner.lock);
+        ++g_taskRunner.stats.numTasksRun;
+        g_taskRunner.stats.totalWaitTicks += waitTicks;
+        if (waitTicks > g_taskRunner.stats.maxWaitTicks) {
+            g_taskRunner.stats.maxWaitTicks = waitTicks;
+        }
+        LightLock_Unlock(&g_taskRunner.lock);
+
+        t->task(t->argStorage);
+
+        LightLock_Lock(&g_taskRunner.lock);
+        g_taskRunner.head = (g_taskRunner.head + 1) % TASKRUNNER_MAX_TASKS;
+        --g_taskRunner.numQueued;
+        LightLock_Unlock(&g_taskRunner.lock);
     }
 }
@@ -3,16 +3,36 @@
 #include <3ds/types.h>
 #include <3ds/synchronization.h>
 
-typedef struct TaskRunner {
-    LightEvent readyEvent;
-    LightEvent parametersSetEvent;
+#define TASKRUNNER_MAX_TASKS    8
+
+typedef struct TaskRunnerTask {
     void (*task)(void *argdata);
+    u64 enqueuedTick;
     u8 argStorage[0x40];
+} TaskRunnerTask;
+
+typedef struct TaskRunnerStats {
+    u32 numTasksRun;
+    u32 numTasksRejected;   ///< Because the queue was full
+    u32 maxQueueDepth;
+    u64 totalWaitTicks;     ///< Time spent in the queue before running
+    u64 maxWaitTicks;
+} TaskRunnerStats;
+
+typedef struct TaskRunner {
+    LightLock lock;
+    LightSemaphore pendingTasks;
+    TaskRunnerTask tasks[TASKRUNNER_MAX_TASKS]; ///< Ring buffer, the head task stays in place while it runs
+    u32 head;
+    u32 numQueued;
+    TaskRunnerStats stats;
 } TaskRunner;
 
 extern TaskRunner g_taskRunner;
 
 void TaskRunner_Init(void);
-void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize);
+/// Doesn't block, fails if the queue is full
+Result TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize);
+void TaskRunner_GetStats(TaskRunnerStats *outStats, u32 *outQueueDepth);
 /// Thread function
 void TaskRunner_HandleTasks(void *p);
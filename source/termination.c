@@ -2,86 +2,164 @@
 #include "termination.h"
 #include "info.h"
 #include "manager.h"
+#include "idle_pool.h"
+#include "exit_stats.h"
+#include "launch_reservations.h"
 #include "util.h"
-#include "exheader_info_heap.h"
 #include "task_runner.h"
 
-static Result terminateUnusedDependencies(const u64 *dependencies, u32 numDeps)
+// Needs the list lock. The process must be a running autoloaded process, that isn't idle. Adds at most one entry to
+// pending (either the process, or the one it evicted from the idle pool): notifications are srv IPCs, they're sent by
+// the caller once it has released the lock
+static void releaseDependency(ProcessData *process, PendingTermination *pending, u32 *numPending)
+{
+    if (--process->refcount > 0 || IdlePool_Park(process, pending, numPending)) {
+        // Still used, or kept for later
+        return;
+    }
+
+    ProcessList_PrepareTerminationNotification(&g_manager.processList, process, &pending[(*numPending)++]);
+}
+
+static inline bool isReleasable(const ProcessData *process)
+{
+    return ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_RUNNING &&
+        (ProcessList_GetFlags(&g_manager.processList, process) & (PROCESSFLAG_AUTOLOADED | PROCESSFLAG_IDLE)) == PROCESSFLAG_AUTOLOADED;
+}
+
+Result terminateUnusedDependencies(const u64 *dependencies, u32 numDeps)
 {
     ProcessData *process;
-    Result res = 0;
+    PendingTermination pending[48]; // one process per title at most
+    u32 numPending = 0;
 
     ProcessList_Lock(&g_manager.processList);
     FOREACH_PROCESS(&g_manager.processList, process) {
-        if (process->terminationStatus != TERMSTATUS_RUNNING || !(process->flags & PROCESSFLAG_AUTOLOADED)) {
+        if (!isReleasable(process)) {
             continue;
         }
 
         u32 i;
         for (i = 0; i < numDeps && dependencies[i] != process->titleId; i++);
 
-        if (i >= numDeps || --process->refcount > 0) {
-            // Process not a listed dependency or still used
-            continue;
+        if (i < numDeps) {
+            releaseDependency(process, pending, &numPending);
         }
+    }
+    ProcessList_Unlock(&g_manager.processList);
 
-        res = ProcessData_SendTerminationNotification(process);
-        res = R_SUMMARY(res) == RS_NOTFOUND ? 0 : res;
+    return ProcessList_SendPendingTerminationNotifications(&g_manager.processList, pending, numPending);
+}
+
+Result releaseDependencyRefs(const ProcessRef *refs, u32 numRefs)
+{
+    PendingTermination pending[48];
+    Result res = 0;
+
+    for (u32 start = 0; start < numRefs; start += 48) {
+        u32 numPending = 0;
 
-        if (R_FAILED(res)) {
-            assertSuccess(svcTerminateProcess(process->handle));
+        ProcessList_Lock(&g_manager.processList);
+        for (u32 i = start; i < numRefs && i < start + 48; i++) {
+            ProcessData *process = ProcessList_ResolveRef(&g_manager.processList, refs[i]);
+            if (process != NULL && isReleasable(process)) {
+                releaseDependency(process, pending, &numPending);
+            }
         }
+        ProcessList_Unlock(&g_manager.processList);
+
+        Result sendRes = ProcessList_SendPendingTerminationNotifications(&g_manager.processList, pending, numPending);
+        res = R_FAILED(sendRes) ? sendRes : res;
     }
 
-    ProcessList_Unlock(&g_manager.processList);
     return res;
 }
 
-Result listAndTerminateDependencies(ProcessData *process, ExHeader_Info *exheaderInfo)
+Result listAndTerminateDependencies(const ProcessSnapshot *snapshot)
 {
     Result res = 0;
     u64 dependencies[48]; // note: official pm reuses exheaderInfo to save space
     u32 numDeps = 0;
 
-    TRY(getAndListDependencies(dependencies, &numDeps, process, exheaderInfo));
+    TRY(getAndListSnapshotDependencies(dependencies, &numDeps, snapshot));
     return terminateUnusedDependencies(dependencies, numDeps);
 }
 
-static Result terminateProcessImpl(ProcessData *process, ExHeader_Info *exheaderInfo)
+// Deadlines are absolute, in ticks; 0 means none (then commitPendingTerminations applies its own timeout)
+static inline u64 getTerminationDeadline(s64 timeout)
+{
+    return timeout >= 0 ? svcGetSystemTick() + nsToTicks(timeout) : 0;
+}
+
+// Needs the list lock
+static void sendTerminationNotification(ProcessData *process, u64 deadline)
+{
+    ProcessList_SendTerminationNotification(&g_manager.processList, process);
+    if (ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_NOTIFICATION_SENT && deadline != 0) {
+        ProcessList_SetTerminationDeadline(&g_manager.processList, process, deadline);
+    }
+}
+
+static Result terminateProcessImpl(ProcessData *process, u64 deadline)
 {
     // NOTE: list dependencies BEFORE sending the notification -- race condition material
     Result res = 0;
     u64 dependencies[48]; // note: official pm reuses exheaderInfo to save space
     u32 numDeps = 0;
 
-    if (process->flags & PROCESSFLAG_DEPENDENCIES_LOADED) {
-        TRY(getAndListDependencies(dependencies, &numDeps, process, exheaderInfo));
-        process->flags &= ~PROCESSFLAG_DEPENDENCIES_LOADED;
-        ProcessData_SendTerminationNotification(process);
+    if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_DEPENDENCIES_LOADED) {
+        TRY(getAndListDependencies(dependencies, &numDeps, process));
+        ProcessList_RemoveFlags(&g_manager.processList, process, PROCESSFLAG_DEPENDENCIES_LOADED);
+        sendTerminationNotification(process, deadline);
         return terminateUnusedDependencies(dependencies, numDeps);
     } else {
-        ProcessData_SendTerminationNotification(process);
+        sendTerminationNotification(process, deadline);
         return 0;
     }
 }
 
-static Result commitPendingTerminations(s64 timeout)
+// Marks the outcome of the batch entry the process belongs to, if any. A failure takes precedence
+static inline void setForcedOutcome(u32 *batchOutcomes, const ProcessColdData *cold)
 {
-    // Wait for all of the processes that have received notification 0x100 to terminate
-    // till the timeout, then actually terminate these processes, etc.
+    if (batchOutcomes != NULL && cold->batchEntry != 0 && batchOutcomes[cold->batchEntry - 1] != TERMINATIONOUTCOME_FAILED) {
+        batchOutcomes[cold->batchEntry - 1] = TERMINATIONOUTCOME_FORCED;
+    }
+}
+
+static Result commitPendingTerminations(s64 timeout, u32 *batchOutcomes)
+{
+    // Wait for all of the processes that have received notification 0x100 to terminate,
+    // actually terminating each of them once its own deadline has passed. Processes without
+    // a deadline get one from the timeout (none if negative).
 
     Result res = 0;
     bool atLeastOneListener = false;
+    u64 defaultDeadline = getTerminationDeadline(timeout);
     ProcessList_Lock(&g_manager.processList);
 
     ProcessData *process;
     FOREACH_PROCESS(&g_manager.processList, process) {
-        switch (process->terminationStatus) {
-            case TERMSTATUS_NOTIFICATION_SENT:
+        ProcessColdData *cold = ProcessList_GetColdData(&g_manager.processList, process);
+        switch (ProcessList_GetTerminationStatus(&g_manager.processList, process)) {
+            case TERMSTATUS_NOTIFICATION_SENT: {
                 atLeastOneListener = true;
+                u64 deadline = cold->deadlineHeapSlot != PROCESSINDEX_EMPTY ? cold->terminationDeadline : defaultDeadline;
+                s64 adaptiveTimeout = ExitStats_GetAdaptiveTimeout(process->titleId);
+
+                // Adaptive mode only brings the deadline closer; waiting forever stays waiting forever
+                cold->adaptiveDeadline = deadline != 0 && adaptiveTimeout >= 0 && cold->terminationNotifiedTick + adaptiveTimeout < deadline;
+                if (cold->adaptiveDeadline) {
+                    deadline = cold->terminationNotifiedTick + adaptiveTimeout;
+                }
+
+                if (deadline != 0) {
+                    ProcessList_SetTerminationDeadline(&g_manager.processList, process, deadline);
+                }
                 break;
+            }
             case TERMSTATUS_NOTIFICATION_FAILED:
-                res = svcTerminateProcess(process->handle); // official pm does not panic on failure here
+                res = svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process)); // official pm does not panic on failure here
+                setForcedOutcome(batchOutcomes, cold);
                 break;
             default:
                 break;
@@ -90,30 +168,77 @@ static Result commitPendingTerminations(s64 timeout)
 
     ProcessList_Unlock(&g_manager.processList);
 
-    if (atLeastOneListener) {
-        Result res = assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, timeout));
+    if (!atLeastOneListener) {
+        return 0;
+    }
 
-        if (R_DESCRIPTION(res) == RD_TIMEOUT) {
-            ProcessList_Lock(&g_manager.processList);
+    res = 0;
+    for (;;) {
+        s64 waitTimeout = -1LL;
 
-            ProcessData *process;
-            FOREACH_PROCESS(&g_manager.processList, process) {
-                if (process->terminationStatus == TERMSTATUS_NOTIFICATION_SENT) {
-                    res = svcTerminateProcess(process->handle);
-                }
+        // Terminate whatever is past its deadline, then sleep until the nearest one
+        ProcessList_Lock(&g_manager.processList);
+        u64 now = svcGetSystemTick();
+        while ((process = ProcessList_GetNearestTerminationDeadline(&g_manager.processList)) != NULL) {
+            ProcessColdData *cold = ProcessList_GetColdData(&g_manager.processList, process);
+            if (cold->terminationDeadline > now) {
+                waitTimeout = ticksToNs(cold->terminationDeadline - now);
+                break;
             }
 
-            ProcessList_Unlock(&g_manager.processList);
+            res = svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process));
+            cold->forceTerminated = true;
+            if (cold->adaptiveDeadline) {
+                ExitStats_RecordCensored(process->titleId, now - cold->terminationNotifiedTick);
+            }
+            setForcedOutcome(batchOutcomes, cold);
+            ProcessList_ClearTerminationDeadline(&g_manager.processList, process);
+        }
+        ProcessList_Unlock(&g_manager.processList);
 
-            assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, -1LL));
+        if (R_DESCRIPTION(assertSuccess(svcWaitSynchronization(g_manager.allNotifiedTerminationEvent, waitTimeout))) != RD_TIMEOUT) {
+            break;
         }
-    } else {
-        res = 0;
     }
 
     return res;
 }
 
+// Needs the list lock. Returns TERMINATIONOUTCOME_FAILED if a matching process is still running without having been
+// notified (e.g. its dependencies couldn't be listed), GRACEFUL until commitPendingTerminations says otherwise
+static TerminationOutcome terminateProcessOrTitleImpl(u64 id, bool useTitleId, u64 deadline, u8 batchEntry, bool *notify, u8 *variation)
+{
+    ProcessData *process;
+    TerminationOutcome outcome = TERMINATIONOUTCOME_NOT_FOUND;
+
+    FOREACH_PROCESS(&g_manager.processList, process) {
+        // It's the only place where it uses the full titleId, and doesn't break after the first result.
+        // Maybe it's to allow killing all the builtins at once with their dummy titleIds? Otherwise,
+        // two processes can't have the same titleId.
+        if ((useTitleId && process->titleId == id) || ProcessList_GetPid(&g_manager.processList, process) == id) {
+            if (outcome == TERMINATIONOUTCOME_NOT_FOUND) {
+                outcome = TERMINATIONOUTCOME_GRACEFUL;
+            }
+            if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_NOTIFY_TERMINATION) {
+                *notify = true;
+                *variation = process->terminatedNotificationVariation;
+                ProcessList_RemoveFlags(&g_manager.processList, process, PROCESSFLAG_NOTIFY_TERMINATION);
+                ProcessList_AddFlags(&g_manager.processList, process, PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED);
+            }
+            terminateProcessImpl(process, deadline);
+            ProcessList_GetColdData(&g_manager.processList, process)->batchEntry = batchEntry;
+            if (ProcessList_GetTerminationStatus(&g_manager.processList, process) == TERMSTATUS_RUNNING) {
+                outcome = TERMINATIONOUTCOME_FAILED;
+            }
+            if (!useTitleId) {
+                break;
+            }
+        }
+    }
+
+    return outcome;
+}
+
 static void TerminateProcessOrTitleAsync(void *argdata)
 {
     struct {
@@ -122,43 +247,21 @@ static void TerminateProcessOrTitleAsync(void *argdata)
         bool useTitleId;
     } *args = argdata;
 
-    ProcessData *process;
     bool notify = false;
-    u8 variation;
+    u8 variation = 0;
+    u64 deadline = getTerminationDeadline(args->timeout);
 
     if (args->timeout >= 0) {
         assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
         g_manager.waitingForTermination = true;
     }
 
-    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
-    if (exheaderInfo == NULL) {
-        panic(0);
-    }
-
     ProcessList_Lock(&g_manager.processList);
-    FOREACH_PROCESS(&g_manager.processList, process) {
-        // It's the only place where it uses the full titleId, and doesn't break after the first result.
-        // Maybe it's to allow killing all the builtins at once with their dummy titleIds? Otherwise,
-        // two processes can't have the same titleId.
-        if ((args->useTitleId && process->titleId == args->id) || process->pid == args->id) {
-            if (process->flags & PROCESSFLAG_NOTIFY_TERMINATION) {
-                notify = true;
-                variation = process->terminatedNotificationVariation;
-                process->flags = (process->flags & ~PROCESSFLAG_NOTIFY_TERMINATION) | PROCESSFLAG_NOTIFY_TERMINATION_TERMINATED;
-            }
-            terminateProcessImpl(process, exheaderInfo);
-            if (!args->useTitleId) {
-                break;
-            }
-        }
-    }
+    terminateProcessOrTitleImpl(args->id, args->useTitleId, deadline, 0, &notify, &variation);
     ProcessList_Unlock(&g_manager.processList);
 
-    ExHeaderInfoHeap_Delete(exheaderInfo);
-
     if (args->timeout >= 0) {
-        commitPendingTerminations(args->timeout);
+        commitPendingTerminations(args->timeout, NULL);
         g_manager.waitingForTermination = false;
         if (notify) {
             notifySubscribers(0x110 + variation);
@@ -175,16 +278,16 @@ static Result TerminateProcessOrTitle(u64 id, s64 timeout, bool useTitleId)
             return 0xC8A05801;
         }
 
-        ProcessList_Lock(&g_manager.processList);
+        ProcessList_LockShared(&g_manager.processList);
         FOREACH_PROCESS(&g_manager.processList, process) {
-            if ((useTitleId && process->titleId == id) || process->pid == id) {
-                assertSuccess(svcTerminateProcess(process->handle));
+            if ((useTitleId && process->titleId == id) || ProcessList_GetPid(&g_manager.processList, process) == id) {
+                assertSuccess(svcTerminateProcess(ProcessList_GetHandle(&g_manager.processList, process)));
                 if (!useTitleId) {
                     break;
                 }
             }
         }
-        ProcessList_Unlock(&g_manager.processList);
+        ProcessList_UnlockShared(&g_manager.processList);
 
         return 0;
     } else {
@@ -194,50 +297,164 @@ static Result TerminateProcessOrTitle(u64 id, s64 timeout, bool useTitleId)
             bool useTitleId;
         } args = { id, timeout, useTitleId };
 
-        TaskRunner_RunTask(TerminateProcessOrTitleAsync, &args, sizeof(args));
-        return 0;
+        return TaskRunner_RunTask(TerminateProcessOrTitleAsync, &args, sizeof(args));
     }
 }
 
-Result TerminateApplication(s64 timeout)
+void beginApplicationTermination(s64 timeout)
 {
-    Result res = 0;
+    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
+    g_manager.waitingForTermination = true;
+
+    ProcessList_Lock(&g_manager.processList);
+    if (g_manager.runningApplicationData != NULL) {
+        terminateProcessImpl(g_manager.runningApplicationData, getTerminationDeadline(timeout));
+    }
+    ProcessList_Unlock(&g_manager.processList);
+}
 
+Result endApplicationTermination(s64 timeout)
+{
+    Result res = commitPendingTerminations(timeout, NULL);
+    g_manager.waitingForTermination = false;
+    return res;
+}
+
+Result TerminateApplication(s64 timeout)
+{
     if (g_manager.preparingForReboot) {
         return 0xC8A05801;
     }
 
-    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
-    if (exheaderInfo == NULL) {
-        panic(0);
+    beginApplicationTermination(timeout);
+    return endApplicationTermination(timeout);
+}
+
+Result TerminateTitle(u64 titleId, s64 timeout)
+{
+    return TerminateProcessOrTitle(titleId, timeout, true);
+}
+
+Result TerminateProcess(u32 pid, s64 timeout)
+{
+    return TerminateProcessOrTitle(pid, timeout, false);
+}
+
+Result TerminateBatch(u32 *outOutcomes, const TerminationBatchEntry *entries, u32 numEntries, s64 timeout)
+{
+    u8 variations[TERMINATIONBATCH_MAX_ENTRIES];
+    u32 numNotifications = 0;
+    u64 deadline = getTerminationDeadline(timeout);
+
+    if (g_manager.preparingForReboot) {
+        return 0xC8A05801;
+    } else if (numEntries > TERMINATIONBATCH_MAX_ENTRIES) {
+        return 0xD8E05BF4;
     }
 
-    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
-    g_manager.waitingForTermination = true;
+    // Like TerminateTitle and TerminateProcess, a negative timeout means the processes are only notified
+    if (timeout >= 0) {
+        assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
+        g_manager.waitingForTermination = true;
+    }
 
     ProcessList_Lock(&g_manager.processList);
-    if (g_manager.runningApplicationData != NULL) {
-
-        terminateProcessImpl(g_manager.runningApplicationData, exheaderInfo);
+    for (u32 i = 0; i < numEntries; i++) {
+        bool notify = false;
+        u8 variation = 0;
+        // Untagged if there is no wait, otherwise a later batch could see the tag
+        u8 batchEntry = timeout >= 0 ? (u8)(i + 1) : 0;
+        outOutcomes[i] = terminateProcessOrTitleImpl(entries[i].id, entries[i].useTitleId != 0, deadline, batchEntry, &notify, &variation);
+        if (notify) {
+            variations[numNotifications++] = variation;
+        }
     }
     ProcessList_Unlock(&g_manager.processList);
 
-    res = commitPendingTerminations(timeout);
+    if (timeout < 0) {
+        return 0;
+    }
 
-    ExHeaderInfoHeap_Delete(exheaderInfo);
+    // One wait for everything; forced terminations overwrite the outcome of their entry
+    Result res = commitPendingTerminations(timeout, outOutcomes);
     g_manager.waitingForTermination = false;
 
+    for (u32 i = 0; i < numNotifications; i++) {
+        notifySubscribers(0x110 + variations[i]);
+    }
+
     return res;
 }
 
-Result TerminateTitle(u64 titleId, s64 timeout)
+static ShutdownStats g_lastShutdownStats;
+
+#define SHUTDOWNWAVE_NONE 0xFF
+
+// A process is put in a later wave than everything that depends on it. Needs the list lock.
+// Only the dependency lists cached at launch are used, walked in place: asking the loader for the others would mean an
+// IPC per process and pass with the lock held. Processes without one (e.g. KIPs) just don't hold anything back.
+static u32 planShutdownWaves(void)
 {
-    return TerminateProcessOrTitle(titleId, timeout, true);
+    ProcessList *list = &g_manager.processList;
+    ProcessData *process;
+    u32 numWaves = 0;
+    bool changed = true;
+
+    for (u32 pass = 0; changed && pass < SHUTDOWN_MAX_WAVES; pass++) {
+        changed = false;
+        FOREACH_PROCESS(list, process) {
+            u8 wave = ProcessList_GetColdData(list, process)->shutdownWave;
+            if (wave == SHUTDOWNWAVE_NONE || wave + 1 >= SHUTDOWN_MAX_WAVES || !(ProcessList_GetFlags(list, process) & PROCESSFLAG_DEPENDENCIES_CACHED)) {
+                continue;
+            }
+
+            for (u16 id = process->dependencyChunk; id != PROCESSINDEX_EMPTY; id = list->dependencyChunks[id].next) {
+                const DependencyChunk *chunk = &list->dependencyChunks[id];
+                for (u32 i = 0; i < chunk->count; i++) {
+                    ProcessData *dep = ProcessList_FindProcessByTitleId(list, (DEPENDENCY_TID_HIGH << 32) | chunk->titleIdLows[i]);
+                    ProcessColdData *depCold = dep != NULL ? ProcessList_GetColdData(list, dep) : NULL;
+                    if (depCold != NULL && depCold->shutdownWave != SHUTDOWNWAVE_NONE && depCold->shutdownWave <= wave) {
+                        depCold->shutdownWave = wave + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    FOREACH_PROCESS(list, process) {
+        u8 wave = ProcessList_GetColdData(list, process)->shutdownWave;
+        if (wave != SHUTDOWNWAVE_NONE && wave + 1u > numWaves) {
+            numWaves = wave + 1;
+        }
+    }
+
+    return numWaves;
 }
 
-Result TerminateProcess(u32 pid, s64 timeout)
+static void runShutdownWave(ShutdownWaveStats *stats, u8 wave, u64 deadline)
 {
-    return TerminateProcessOrTitle(pid, timeout, false);
+    ProcessData *process;
+    u64 startTick = svcGetSystemTick();
+
+    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
+    g_manager.waitingForTermination = true;
+
+    stats->numProcesses = 0;
+    ProcessList_Lock(&g_manager.processList);
+    FOREACH_PROCESS(&g_manager.processList, process) {
+        if (ProcessList_GetColdData(&g_manager.processList, process)->shutdownWave == wave) {
+            sendTerminationNotification(process, deadline);
+            ++stats->numProcesses;
+        }
+    }
+    ProcessList_Unlock(&g_manager.processList);
+
+    // Returns as soon as the wave has drained. Stragglers from earlier waves keep their own deadline
+    commitPendingTerminations(ticksToNs(deadline > startTick ? deadline - startTick : 0), NULL);
+    g_manager.waitingForTermination = false;
+
+    stats->ticks = svcGetSystemTick() - startTick;
 }
 
 ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
@@ -248,15 +465,7 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
 
     u64 dependencies[48];
     u32 numDeps = 0;
-
-    ExHeader_Info *exheaderInfo = ExHeaderInfoHeap_New();
-
-    if (exheaderInfo == NULL) {
-        panic(0);
-    }
-
-    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
-    g_manager.waitingForTermination = true;
+    u32 numWaves;
 
     // List the dependencies of the caller
     if (callerPid != (u32)-1) {
@@ -264,25 +473,25 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
         process = ProcessList_FindProcessById(&g_manager.processList, callerPid);
         if (process != NULL) {
             callerProcess = process;
-            getAndListDependencies(dependencies, &numDeps, process, exheaderInfo);
+            getAndListDependencies(dependencies, &numDeps, process);
         }
         ProcessList_Unlock(&g_manager.processList);
     }
 
-    // Send notification 0x100 to the currently running application
     ProcessList_Lock(&g_manager.processList);
     if (g_manager.runningApplicationData != NULL) {
-        g_manager.runningApplicationData->flags &= ~PROCESSFLAG_DEPENDENCIES_LOADED;
-        ProcessData_SendTerminationNotification(g_manager.runningApplicationData);
+        ProcessList_RemoveFlags(&g_manager.processList, g_manager.runningApplicationData, PROCESSFLAG_DEPENDENCIES_LOADED);
     }
 
-    // Send notification 0x100 to anything but the caller deps or the caller; and *increase* the refcount of the latter if autoloaded
+    // Terminate anything but the caller deps or the caller; and *increase* the refcount of the latter if autoloaded
     // Ignore KIPs
     FOREACH_PROCESS(&g_manager.processList, process) {
-        if (process->flags & PROCESSFLAG_KIP) {
+        ProcessColdData *cold = ProcessList_GetColdData(&g_manager.processList, process);
+        cold->shutdownWave = SHUTDOWNWAVE_NONE;
+        if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_KIP) {
             continue;
-        } else if (process == callerProcess && (process->flags & PROCESSFLAG_AUTOLOADED) != 0) {
-            ProcessData_Incref(process, 1);
+        } else if (process == callerProcess && (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_AUTOLOADED) != 0) {
+            ProcessList_Incref(&g_manager.processList, process, 1);
             continue;
         }
 
@@ -290,40 +499,53 @@ ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout)
         for (i = 0; i < numDeps && dependencies[i] != process->titleId; i++);
 
         if (i >= numDeps) {
-            // Process not a listed dependency: send notification 0x100
-            ProcessData_SendTerminationNotification(process);
-        } else if (process->flags & PROCESSFLAG_AUTOLOADED){
-            ProcessData_Incref(process, 1);
+            // Process not a listed dependency: to be sent notification 0x100
+            cold->shutdownWave = 0;
+        } else if (ProcessList_GetFlags(&g_manager.processList, process) & PROCESSFLAG_AUTOLOADED){
+            ProcessList_Incref(&g_manager.processList, process, 1);
         }
     }
+
+    if (g_manager.runningApplicationData != NULL) {
+        // Always notified, like in official PM
+        ProcessList_GetColdData(&g_manager.processList, g_manager.runningApplicationData)->shutdownWave = 0;
+    }
+
+    // Official PM notifies everything at once, and waits for the whole set with a single deadline. Instead, go from
+    // the application and applets down to the leaf sysmodules, so that nothing waits behind a straggler it doesn't depend on
+    numWaves = planShutdownWaves();
     ProcessList_Unlock(&g_manager.processList);
-    ExHeaderInfoHeap_Delete(exheaderInfo);
 
-    s64 timeoutTicks = dstTimePoint - svcGetSystemTick();
-    commitPendingTerminations(timeoutTicks >= 0 ? ticksToNs(timeoutTicks) : 0LL);
-    g_manager.waitingForTermination = false;
+    // Each wave gets an even share of what's left of the budget
+    for (u32 wave = 0; wave < numWaves; wave++) {
+        u64 now = svcGetSystemTick();
+        u64 share = dstTimePoint > now ? (dstTimePoint - now) / (numWaves - wave) : 0;
+        runShutdownWave(&g_lastShutdownStats.waves[wave], (u8)wave, now + share);
+    }
 
     // Now, send termination notification to PXI (PID 4)
-    assertSuccess(svcClearEvent(g_manager.allNotifiedTerminationEvent));
-    g_manager.waitingForTermination = true;
-
     ProcessList_Lock(&g_manager.processList);
     process = ProcessList_FindProcessById(&g_manager.processList, 4);
     if (process != NULL) {
-        ProcessData_SendTerminationNotification(process);
+        ProcessList_GetColdData(&g_manager.processList, process)->shutdownWave = numWaves;
     } else {
         panic(0LL);
     }
     ProcessList_Unlock(&g_manager.processList);
 
     // Allow 1.5 extra seconds for PXI (approx 402167783 ticks)
-    timeoutTicks = dstTimePoint - svcGetSystemTick();
-    commitPendingTerminations(1500 * 1000 * 1000LL + (timeoutTicks >= 0 ? ticksToNs(timeoutTicks) : 0LL));
-    g_manager.waitingForTermination = false;
+    u64 now = svcGetSystemTick();
+    runShutdownWave(&g_lastShutdownStats.waves[numWaves], (u8)numWaves, (dstTimePoint > now ? dstTimePoint : now) + nsToTicks(1500 * 1000 * 1000LL));
+    g_lastShutdownStats.numWaves = numWaves + 1;
 
     return callerProcess;
 }
 
+void getLastShutdownStats(ShutdownStats *outStats)
+{
+    *outStats = g_lastShutdownStats;
+}
+
 static void PrepareForRebootAsync(void *argdata)
 {
     struct {
@@ -331,9 +553,11 @@ static void PrepareForRebootAsync(void *argdata)
         s64 timeout;
     } *args = argdata;
 
+    LaunchReservations_ReleaseAll();
+
     ProcessData *caller = terminateAllProcesses(args->pid, args->timeout);
     if (caller != NULL) {
-        ProcessData_Notify(caller, 0x179);
+        ProcessList_Notify(&g_manager.processList, caller, 0x179);
     }
 }
 
@@ -349,6 +573,10 @@ Result PrepareForReboot(u32 pid, s64 timeout)
     }
 
     g_manager.preparingForReboot = true;
-    TaskRunner_RunTask(PrepareForRebootAsync, &args, sizeof(args));
-    return 0;
+    Result res = TaskRunner_RunTask(PrepareForRebootAsync, &args, sizeof(args));
+    if (R_FAILED(res)) {
+        g_manager.preparingForReboot = false;
+    }
+
+    return res;
 }
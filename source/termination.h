@@ -1,12 +1,53 @@
 #pragma once
 
 #include "process_data.h"
-#include <3ds/exheader.h>
 
-Result listAndTerminateDependencies(ProcessData *process, ExHeader_Info *exheaderInfo);
+Result terminateUnusedDependencies(const u64 *dependencies, u32 numDeps); // decrefs the listed autoloaded processes
+Result releaseDependencyRefs(const ProcessRef *refs, u32 numRefs); // same, for references taken with ProcessList_Incref
+Result listAndTerminateDependencies(const ProcessSnapshot *snapshot);
+
+// TerminateApplication, in two halves: sending the notifications, then waiting for the termination to complete
+void beginApplicationTermination(s64 timeout);
+Result endApplicationTermination(s64 timeout);
+
+// terminateAllProcesses goes in waves, dependents before their dependencies; PXI has a wave of its own, last
+#define SHUTDOWN_MAX_WAVES 8
+
+typedef struct ShutdownWaveStats {
+    u32 numProcesses;
+    u32 reserved;
+    u64 ticks;
+} ShutdownWaveStats;
+
+typedef struct ShutdownStats {
+    u32 numWaves;
+    u32 reserved;
+    ShutdownWaveStats waves[SHUTDOWN_MAX_WAVES + 1];
+} ShutdownStats;
+
 ProcessData *terminateAllProcesses(u32 callerPid, s64 timeout); // callerPid = -1 for firmlaunch
+void getLastShutdownStats(ShutdownStats *outStats);
 
 Result TerminateApplication(s64 timeout);
 Result TerminateTitle(u64 titleId, s64 timeout);
 Result TerminateProcess(u32 pid, s64 timeout);
+
+#define TERMINATIONBATCH_MAX_ENTRIES 32
+
+typedef struct TerminationBatchEntry {
+    u64 id;
+    u32 useTitleId; ///< id is a pid if 0
+    u32 reserved;
+} TerminationBatchEntry;
+
+typedef enum TerminationOutcome {
+    TERMINATIONOUTCOME_NOT_FOUND    = 0,
+    TERMINATIONOUTCOME_GRACEFUL     = 1,
+    TERMINATIONOUTCOME_FORCED       = 2, ///< at least one matching process had to be terminated with svcTerminateProcess
+    TERMINATIONOUTCOME_FAILED       = 3, ///< at least one matching process couldn't be notified and is still running
+} TerminationOutcome;
+
+/// TerminateTitle/TerminateProcess for each entry, with a single wait for all of them. Blocks until done, unless the
+/// timeout is negative: then the processes are only notified, and the outcomes are those known at that point.
+Result TerminateBatch(u32 *outOutcomes, const TerminationBatchEntry *entries, u32 numEntries, s64 timeout);
 Result PrepareForReboot(u32 pid, s64 timeout);
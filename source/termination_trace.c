@@ -0,0 +1,78 @@
+#include <3ds.h>
+#include <string.h>
+#include "termination_trace.h"
+
+static struct {
+    LightLock lock;
+    u32 head;
+    u32 numRecords;
+    TerminationTraceRecord records[TERMINATIONTRACE_NUM_RECORDS];
+    TerminationTraceStats stats[LAUNCHCATEGORY_COUNT][TERMINATIONTRACE_INTERVAL_COUNT];
+} g_terminationTrace;
+
+void TerminationTrace_Init(void)
+{
+    memset(&g_terminationTrace, 0, sizeof(g_terminationTrace));
+    LightLock_Init(&g_terminationTrace.lock);
+}
+
+static void addSample(TerminationTraceStats *stats, u64 ticks64)
+{
+    u32 ticks = ticks64 > 0xFFFFFFFFULL ? 0xFFFFFFFF : (u32)ticks64;
+    stats->maxTicks = ticks > stats->maxTicks ? ticks : stats->maxTicks;
+    stats->totalTicks += ticks;
+    ++stats->histogram[LaunchStats_GetBucket(ticks)];
+    ++stats->count;
+}
+
+void TerminationTrace_Record(const ProcessSnapshot *snapshot, u64 reapedTick)
+{
+    TerminationTraceRecord record = {
+        .titleId = snapshot->data.titleId,
+        .pid = snapshot->pid,
+        .category = (u8)LaunchStats_GetCategory(snapshot->data.reslimitCategory),
+        .forced = snapshot->cold.forceTerminated,
+        .notifiedTick = snapshot->cold.terminationNotifiedTick,
+        .exitTick = snapshot->cold.exitTick,
+        .reapedTick = reapedTick,
+    };
+
+    LightLock_Lock(&g_terminationTrace.lock);
+
+    u32 tail = g_terminationTrace.head + g_terminationTrace.numRecords;
+    g_terminationTrace.records[tail >= TERMINATIONTRACE_NUM_RECORDS ? tail - TERMINATIONTRACE_NUM_RECORDS : tail] = record;
+    if (g_terminationTrace.numRecords < TERMINATIONTRACE_NUM_RECORDS) {
+        ++g_terminationTrace.numRecords;
+    } else {
+        g_terminationTrace.head = g_terminationTrace.head + 1 >= TERMINATIONTRACE_NUM_RECORDS ? 0 : g_terminationTrace.head + 1;
+    }
+
+    TerminationTraceStats *stats = g_terminationTrace.stats[record.category];
+    if (record.notifiedTick != 0) {
+        addSample(&stats[TERMINATIONTRACE_INTERVAL_EXIT], record.exitTick - record.notifiedTick);
+    }
+    addSample(&stats[TERMINATIONTRACE_INTERVAL_REAP], record.reapedTick - record.exitTick);
+
+    LightLock_Unlock(&g_terminationTrace.lock);
+}
+
+u32 TerminationTrace_GetRecords(TerminationTraceRecord *outRecords, u32 maxRecords)
+{
+    LightLock_Lock(&g_terminationTrace.lock);
+    u32 num = g_terminationTrace.numRecords < maxRecords ? g_terminationTrace.numRecords : maxRecords;
+    u32 start = g_terminationTrace.head + g_terminationTrace.numRecords - num;
+    start = start >= TERMINATIONTRACE_NUM_RECORDS ? start - TERMINATIONTRACE_NUM_RECORDS : start;
+    for (u32 i = 0, pos = start; i < num; i++, pos = pos + 1 >= TERMINATIONTRACE_NUM_RECORDS ? 0 : pos + 1) {
+        outRecords[i] = g_terminationTrace.records[pos];
+    }
+    LightLock_Unlock(&g_terminationTrace.lock);
+
+    return num;
+}
+
+void TerminationTrace_GetStats(TerminationTraceStats *outStats, LaunchCategory category)
+{
+    LightLock_Lock(&g_terminationTrace.lock);
+    memcpy(outStats, g_terminationTrace.stats[category], sizeof(g_terminationTrace.stats[category]));
+    LightLock_Unlock(&g_terminationTrace.lock);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "launch_stats.h"
+#include "process_data.h"
+
+// Timestamps of the last terminations, to tell "the process was slow to exit" from "PM was slow to notice or reap it":
+// termination notification sent, exit seen by the monitor, cleanup (unregistration from sm/fs/loader) done.
+
+#define TERMINATIONTRACE_NUM_RECORDS 64
+
+typedef struct TerminationTraceRecord {
+    u64 titleId;
+    u32 pid;
+    u8 category;        ///< LaunchCategory
+    u8 forced;          ///< terminated with svcTerminateProcess after its deadline
+    u16 reserved;
+    u64 notifiedTick;   ///< 0 if the process exited on its own
+    u64 exitTick;
+    u64 reapedTick;
+} TerminationTraceRecord;
+
+typedef enum TerminationTraceInterval {
+    TERMINATIONTRACE_INTERVAL_EXIT = 0, ///< notification sent -> exit seen (not counted for processes that exited on their own)
+    TERMINATIONTRACE_INTERVAL_REAP,     ///< exit seen -> cleanup done
+
+    TERMINATIONTRACE_INTERVAL_COUNT,
+} TerminationTraceInterval;
+
+/// Same buckets as LaunchStageStats
+typedef struct TerminationTraceStats {
+    u32 count;
+    u32 maxTicks;
+    u64 totalTicks;
+    u32 histogram[LAUNCHSTATS_NUM_BUCKETS];
+} TerminationTraceStats;
+
+void TerminationTrace_Init(void);
+
+/// Called once the process has been cleaned up, with the snapshot taken when it exited
+void TerminationTrace_Record(const ProcessSnapshot *snapshot, u64 reapedTick);
+
+/// Copies the most recent records, oldest first. Returns how many were copied.
+u32 TerminationTrace_GetRecords(TerminationTraceRecord *outRecords, u32 maxRecords);
+void TerminationTrace_GetStats(TerminationTraceStats *outStats, LaunchCategory category); // TERMINATIONTRACE_INTERVAL_COUNT entries
@@ -0,0 +1,143 @@
+#include <3ds.h>
+#include <string.h>
+#include "title_info_cache.h"
+#include "util.h"
+
+typedef struct TitleInfoCacheEntry {
+    u64 programId;
+    u32 lastUsed; ///< 0: unused entry
+    u8 mediaType;
+    ExHeader_Arm11CoreInfo coreInfo;
+    ExHeader_SystemInfoFlags siFlags;
+} TitleInfoCacheEntry;
+
+static struct {
+    LightLock lock;
+    u32 clock;
+    u32 generation;
+    TitleInfoCacheStats stats;
+    TitleInfoCacheEntry entries[TITLEINFOCACHE_NUM_ENTRIES];
+} g_titleInfoCache;
+
+void TitleInfoCache_Init(void)
+{
+    memset(&g_titleInfoCache, 0, sizeof(g_titleInfoCache));
+    LightLock_Init(&g_titleInfoCache.lock);
+}
+
+static u32 tick(void)
+{
+    if (++g_titleInfoCache.clock == 0) {
+        // Wrapped around (unlikely), restart from a clean slate rather than renumbering
+        for (u32 i = 0; i < TITLEINFOCACHE_NUM_ENTRIES; i++) {
+            g_titleInfoCache.entries[i].lastUsed = 0;
+        }
+        g_titleInfoCache.clock = 1;
+    }
+
+    return g_titleInfoCache.clock;
+}
+
+static TitleInfoCacheEntry *findEntry(const FS_ProgramInfo *programInfo)
+{
+    for (u32 i = 0; i < TITLEINFOCACHE_NUM_ENTRIES; i++) {
+        TitleInfoCacheEntry *entry = &g_titleInfoCache.entries[i];
+        if (entry->lastUsed != 0 && entry->programId == programInfo->programId && entry->mediaType == programInfo->mediaType) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+bool TitleInfoCache_Lookup(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo, u32 *outGeneration)
+{
+    LightLock_Lock(&g_titleInfoCache.lock);
+    TitleInfoCacheEntry *entry = findEntry(programInfo);
+    if (entry != NULL) {
+        entry->lastUsed = tick();
+        *outCoreInfo = entry->coreInfo;
+        *outSiFlags = entry->siFlags;
+        ++g_titleInfoCache.stats.numHits;
+    } else {
+        *outGeneration = g_titleInfoCache.generation;
+        ++g_titleInfoCache.stats.numMisses;
+    }
+    LightLock_Unlock(&g_titleInfoCache.lock);
+
+    return entry != NULL;
+}
+
+void TitleInfoCache_Insert(const FS_ProgramInfo *programInfo, const ExHeader_Arm11CoreInfo *coreInfo, const ExHeader_SystemInfoFlags *siFlags, u32 generation)
+{
+    LightLock_Lock(&g_titleInfoCache.lock);
+    if (generation == g_titleInfoCache.generation) {
+        TitleInfoCacheEntry *entry = findEntry(programInfo);
+
+        if (entry == NULL) {
+            // Pick an unused entry, or evict the least recently used one
+            entry = &g_titleInfoCache.entries[0];
+            for (u32 i = 1; i < TITLEINFOCACHE_NUM_ENTRIES && entry->lastUsed != 0; i++) {
+                if (g_titleInfoCache.entries[i].lastUsed < entry->lastUsed) {
+                    entry = &g_titleInfoCache.entries[i];
+                }
+            }
+        }
+
+        entry->programId = programInfo->programId;
+        entry->mediaType = programInfo->mediaType;
+        entry->coreInfo = *coreInfo;
+        entry->siFlags = *siFlags;
+        entry->lastUsed = tick();
+    }
+    LightLock_Unlock(&g_titleInfoCache.lock);
+}
+
+static void invalidate(u64 programId, bool matchProgramId, u8 mediaType, bool matchMediaType)
+{
+    LightLock_Lock(&g_titleInfoCache.lock);
+    for (u32 i = 0; i < TITLEINFOCACHE_NUM_ENTRIES; i++) {
+        TitleInfoCacheEntry *entry = &g_titleInfoCache.entries[i];
+        if ((!matchProgramId || entry->programId == programId) && (!matchMediaType || entry->mediaType == mediaType)) {
+            entry->lastUsed = 0;
+        }
+    }
+
+    // Lookups that missed before this point may be about to insert outdated data
+    ++g_titleInfoCache.generation;
+    ++g_titleInfoCache.stats.numInvalidations;
+    LightLock_Unlock(&g_titleInfoCache.lock);
+}
+
+void TitleInfoCache_InvalidateTitle(u64 programId)
+{
+    invalidate(programId, true, 0, false);
+}
+
+void TitleInfoCache_InvalidateMediaType(FS_MediaType mediaType)
+{
+    invalidate(0, false, (u8)mediaType, true);
+}
+
+void TitleInfoCache_GetStats(TitleInfoCacheStats *outStats)
+{
+    LightLock_Lock(&g_titleInfoCache.lock);
+    *outStats = g_titleInfoCache.stats;
+    LightLock_Unlock(&g_titleInfoCache.lock);
+}
+
+void TitleInfoCache_HandleMediaNotification(u32 notificationId)
+{
+    switch (notificationId) {
+        case NOTIFICATION_SDCARD_INSERTED:
+        case NOTIFICATION_SDCARD_REMOVED:
+            TitleInfoCache_InvalidateMediaType(MEDIATYPE_SD);
+            break;
+        case NOTIFICATION_GAMECARD_INSERTED:
+        case NOTIFICATION_GAMECARD_REMOVED:
+            TitleInfoCache_InvalidateMediaType(MEDIATYPE_GAME_CARD);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <3ds/exheader.h>
+#include <3ds/services/fs.h>
+
+#define TITLEINFOCACHE_NUM_ENTRIES 16
+
+// srv notifications published by FS
+#define NOTIFICATION_SDCARD_INSERTED    0x207
+#define NOTIFICATION_GAMECARD_INSERTED  0x208
+#define NOTIFICATION_SDCARD_REMOVED     0x209
+#define NOTIFICATION_GAMECARD_REMOVED   0x20A
+
+typedef struct TitleInfoCacheStats {
+    u32 numHits;
+    u32 numMisses;
+    u32 numInvalidations;
+} TitleInfoCacheStats;
+
+void TitleInfoCache_Init(void);
+
+/**
+ * @brief Looks up the cached exheader flags of a title.
+ * @param[out] outGeneration Set on a miss; pass it to @ref TitleInfoCache_Insert so that stale data isn't inserted after an invalidation.
+ * @return true on a hit.
+ */
+bool TitleInfoCache_Lookup(ExHeader_Arm11CoreInfo *outCoreInfo, ExHeader_SystemInfoFlags *outSiFlags, const FS_ProgramInfo *programInfo, u32 *outGeneration);
+void TitleInfoCache_Insert(const FS_ProgramInfo *programInfo, const ExHeader_Arm11CoreInfo *coreInfo, const ExHeader_SystemInfoFlags *siFlags, u32 generation);
+
+void TitleInfoCache_InvalidateTitle(u64 programId);
+void TitleInfoCache_InvalidateMediaType(FS_MediaType mediaType);
+
+void TitleInfoCache_GetStats(TitleInfoCacheStats *outStats);
+
+/// srv notification handler (SD card and game card insertion/removal)
+void TitleInfoCache_HandleMediaNotification(u32 notificationId);
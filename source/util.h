@@ -70,12 +70,27 @@ static inline Result notifySubscribers(u32 notificationId)
     return res;
 }
 
+// The ARM11 has no hardware divider, and 64-bit divisions are slow library calls: use 32.32 fixed-point factors instead.
+// Relative error is below 1e-9, and unlike the naive formulas, nothing overflows for sensible durations.
+_Static_assert(SYSCLOCK_ARM11 == 268111856, "update the tick conversion factors");
+#define NS_TO_TICKS_FACTOR      0x44A2FA85u // frac(SYSCLOCK_ARM11 / 1e9) * 2^32
+#define TICKS_TO_NS_FACTOR      0xBAD34AEFu // frac(1e9 / SYSCLOCK_ARM11) * 2^32, integer part is 3
+
+static inline u64 mulFrac32(u64 x, u32 factor)
+{
+    return (x >> 32) * factor + (((x & 0xFFFFFFFF) * factor) >> 32);
+}
+
 static inline s64 nsToTicks(s64 ns)
 {
-    return ns * SYSCLOCK_ARM11 / (1000 * 1000 * 1000LL);
+    u64 x = ns < 0 ? -(u64)ns : (u64)ns;
+    s64 ticks = (s64)mulFrac32(x, NS_TO_TICKS_FACTOR);
+    return ns < 0 ? -ticks : ticks;
 }
 
 static inline s64 ticksToNs(s64 ticks)
 {
-    return 1000 * 1000 * 1000LL * ticks / SYSCLOCK_ARM11;
+    u64 x = ticks < 0 ? -(u64)ticks : (u64)ticks;
+    s64 ns = (s64)(3 * x + mulFrac32(x, TICKS_TO_NS_FACTOR));
+    return ticks < 0 ? -ns : ns;
 }